@@ -0,0 +1,370 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Times the extraction of a binfile end to end and its hot kernels on their
+ * own. The extractor talks a lot on stderr, that goes to /dev/null while the
+ * clock runs. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "zipfile.h"
+#include "input.h"
+#include "extractor.h"
+#include "pipeline.h"
+#include "regions.h"
+#include "tilecover.h"
+#include "map.h"
+
+typedef struct bench_result bench_result_t;
+struct bench_result {
+    const char * name;
+    double seconds;
+    uint64_t bytes;
+    uint64_t tiles;
+};
+
+static int saved_stderr = -1;
+
+static void usage (void) {
+    fprintf(stderr,"\n"
+            " usage: navit_binfile_bench [options] <binfile> [coordinates]\n"
+            "\n"
+            " Coordinates default to a quarter of the world around 0/0.\n"
+            "\n"
+            " Options\n"
+            "  -r <runs>       best of this many runs (5)\n"
+            "  -j <threads>    threads for the end to end run (1)\n"
+            "  -t <directory>  where outputs go (/tmp)\n"
+            "  -a <areas>      areas for the region filter kernels (1000)\n"
+            "\n");
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void quiet(int on) {
+    if(on) {
+        int null = open("/dev/null", O_WRONLY);
+        fflush(stderr);
+        saved_stderr = dup(2);
+        dup2(null, 2);
+        close(null);
+    } else {
+        fflush(stderr);
+        dup2(saved_stderr, 2);
+        close(saved_stderr);
+    }
+}
+
+static void report(bench_result_t * r) {
+    printf("%-24s %9.3f ms ", r->name, r->seconds * 1e3);
+    if(r->bytes > 0)
+        printf("%9.3f GB/s", r->bytes / r->seconds / 1e9);
+    else
+        printf("%14s", "");
+    printf(" %12.0f tiles/s\n", r->tiles / r->seconds);
+}
+
+static void keep_best(bench_result_t * r, double seconds) {
+    if((r->seconds == 0) || (seconds < r->seconds))
+        r->seconds = seconds;
+}
+
+int main (int argc, char ** argv) {
+    binfile_input_t input;
+    central_directory_t directory;
+    local_file_header_storage_t storage;
+    extract_sink_t sink;
+    bench_result_t result;
+    char ** names;
+    struct rect * bboxes;
+    region_set_t regions;
+    tile_index_t index;
+    cover_area_t cover;
+    uint8_t * candidates;
+    uint64_t * hits;
+    uint64_t scalar_hits = 0;
+    int areas = 1000;
+    int kernel;
+    char output[4096];
+    const char * directory_path = "/tmp";
+    double coordinates[4] = {-90, -45, 90, 45};
+    FILE * infile;
+    FILE * outfile;
+    uint64_t data_size = 0;
+    uint64_t i;
+    int threads = 1;
+    int runs = 5;
+    int run;
+    int c;
+
+    while((c = getopt(argc, argv, "r:j:t:a:h")) != -1) {
+        switch(c) {
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 't':
+            directory_path = optarg;
+            break;
+        case 'a':
+            areas = atoi(optarg);
+            break;
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if(((argc - optind) != 1) && ((argc - optind) != 5)) {
+        usage();
+        exit(1);
+    }
+    if((argc - optind) == 5)
+        for(i = 0; i < 4; i ++)
+            coordinates[i] = atof(argv[optind +1 +i]);
+    if(runs < 1)
+        runs = 1;
+    if(areas < 1)
+        areas = 1;
+    infile = fopen(argv[optind], "r");
+    if((infile == NULL) || (input_open(&input, infile) != 0) || (read_central_directory(&input, &directory) != 0)) {
+        fprintf(stderr, "ERROR %s is not a binfile I can map\n", argv[optind]);
+        exit(1);
+    }
+    sort_central_directory(&directory);
+    names = malloc(directory.count * sizeof(char *));
+    for(i = 0; i < directory.count; i ++) {
+        central_directory_header_t * header = directory.entries[i].header;
+        names[i] = malloc(header->file_name_length +1);
+        memcpy(names[i], header +1, header->file_name_length);
+        names[i][header->file_name_length] = 0;
+        data_size += directory.entries[i].compressed_size;
+    }
+    memset(&sink, 0, sizeof(sink));
+    getmercator(coordinates[0], coordinates[1], coordinates[2], coordinates[3], &sink.area);
+    sink.margin = -1;
+    snprintf(output, sizeof(output), "%s/navit_binfile_bench.%d.bin", directory_path, getpid());
+    printf("%s: %ld tiles, %ld bytes of tile data, best of %d runs\n", argv[optind], directory.count, data_size, runs);
+
+    /* tile_bbox() */
+    memset(&result, 0, sizeof(result));
+    result.name = "tile_bbox";
+    for(run = 0; run < runs; run ++) {
+        struct rect r;
+        int64_t sum = 0;
+        double start = now();
+        for(i = 0; i < directory.count; i ++) {
+            tile_bbox(names[i], &r, 1);
+            sum += r.l.x;
+        }
+        keep_best(&result, now() - start);
+        if(sum == 1)
+            printf(" ");
+    }
+    result.tiles = directory.count;
+    report(&result);
+
+    /* tile_walk_bbox(), the same reusing the prefix shared with the tile before */
+    bboxes = malloc(directory.count * sizeof(struct rect));
+    memset(&result, 0, sizeof(result));
+    result.name = "tile_walk_bbox";
+    for(run = 0; run < runs; run ++) {
+        tile_walk_t walk;
+        double start = now();
+        tile_walk_init(&walk, 1);
+        for(i = 0; i < directory.count; i ++)
+            tile_walk_bbox(&walk, names[i], &(bboxes[i]));
+        keep_best(&result, now() - start);
+    }
+    for(i = 0; i < directory.count; i ++) {
+        struct rect r;
+        tile_bbox(names[i], &r, 1);
+        if(memcmp(&r, &(bboxes[i]), sizeof(r)) != 0) {
+            fprintf(stderr, "ERROR tile_walk_bbox() and tile_bbox() differ for %s\n", names[i]);
+            exit(1);
+        }
+    }
+    result.tiles = directory.count;
+    report(&result);
+
+    /* every tile against many random areas of up to 1/8 of the world, with each kernel the CPU has */
+    srandom(1);
+    region_set_init(&regions, areas);
+    for(c = 0; c < areas; c ++) {
+        struct rect r;
+        r.l.x = WORLD_BOUNDINGBOX_MIN_X + random() % (WORLD_BOUNDINGBOX_MAX_X - WORLD_BOUNDINGBOX_MIN_X);
+        r.l.y = WORLD_BOUNDINGBOX_MIN_Y + random() % (WORLD_BOUNDINGBOX_MAX_Y - WORLD_BOUNDINGBOX_MIN_Y);
+        r.h.x = r.l.x + random() % ((WORLD_BOUNDINGBOX_MAX_X - WORLD_BOUNDINGBOX_MIN_X) / 8);
+        r.h.y = r.l.y + random() % ((WORLD_BOUNDINGBOX_MAX_Y - WORLD_BOUNDINGBOX_MIN_Y) / 8);
+        region_set_put(&regions, c, &r);
+    }
+    hits = malloc(REGION_WORDS(areas) * sizeof(uint64_t));
+    for(kernel = REGION_SCALAR; kernel <= REGION_AVX2; kernel ++) {
+        char name[64];
+        uint64_t found = 0;
+        if(region_set_use(&regions, kernel) != 0)
+            continue;
+        snprintf(name, sizeof(name), "regions %s x%d", region_kernel_name(kernel), areas);
+        memset(&result, 0, sizeof(result));
+        result.name = name;
+        for(run = 0; run < runs; run ++) {
+            double start = now();
+            found = 0;
+            for(i = 0; i < directory.count; i ++) {
+                region_set_test(&regions, &(bboxes[i]), hits);
+                found += hits[0];
+            }
+            keep_best(&result, now() - start);
+        }
+        /* all hits once more outside the clock, they have to agree with the scalar kernel */
+        found = 0;
+        for(i = 0; i < directory.count; i ++) {
+            region_set_test(&regions, &(bboxes[i]), hits);
+            for(c = 0; c < REGION_WORDS(areas); c ++)
+                found += __builtin_popcountll(hits[c]);
+        }
+        if(kernel == REGION_SCALAR)
+            scalar_hits = found;
+        else if(found != scalar_hits) {
+            fprintf(stderr, "ERROR %s kernel found %ld hits, scalar %ld\n", region_kernel_name(kernel), found,
+                    scalar_hits);
+            exit(1);
+        }
+        result.tiles = directory.count;
+        report(&result);
+    }
+    free(hits);
+    region_set_free(&regions);
+    free(bboxes);
+
+    /* filter_file() on the local headers in the map */
+    memset(&result, 0, sizeof(result));
+    result.name = "filter_file";
+    quiet(1);
+    for(run = 0; run < runs; run ++) {
+        double start = now();
+        for(i = 0; i < directory.count; i ++)
+            filter_file((local_file_header_t *)(input.map + directory.entries[i].offset), &sink, 1);
+        keep_best(&result, now() - start);
+    }
+    quiet(0);
+    result.tiles = directory.count;
+    report(&result);
+
+    /* tile_cover_select() of the same area over the index sorted by name */
+    tile_index_from_directory(&index, &directory);
+    tile_index_sort(&index);
+    candidates = malloc(index.count);
+    cover.rect = sink.area;
+    cover.depth = -1;
+    memset(&result, 0, sizeof(result));
+    result.name = "tile_cover_select";
+    for(run = 0; run < runs; run ++) {
+        double start = now();
+        tile_cover_select(&index, &cover, 1, candidates);
+        keep_best(&result, now() - start);
+    }
+    free(candidates);
+    tile_index_free(&index);
+    result.tiles = directory.count;
+    report(&result);
+
+    /* write_central_directory() from remembered headers */
+    memset(&storage, 0, sizeof(storage));
+    for(i = 0; i < directory.count; i ++) {
+        local_file_header_t * local = (local_file_header_t *)(input.map + directory.entries[i].offset);
+        uint64_t size = sizeof(*local) + local->file_name_length + local->extra_field_length;
+        local_file_header_t * header = storage_add_header(&storage, size);
+        memcpy(header, local, size);
+        remember_local_file(&storage, header, directory.entries[i].offset);
+    }
+    memset(&result, 0, sizeof(result));
+    result.name = "write_central_directory";
+    outfile = fopen("/dev/null", "w");
+    for(run = 0; run < runs; run ++) {
+        double start = now();
+        result.bytes = write_central_directory(&storage, outfile);
+        fflush(outfile);
+        keep_best(&result, now() - start);
+    }
+    fclose(outfile);
+    free_storage(&storage);
+    result.tiles = directory.count;
+    report(&result);
+
+    /* copy_file_data() of all the tile data at once */
+    memset(&result, 0, sizeof(result));
+    result.name = "copy_file_data";
+    for(run = 0; run < runs; run ++) {
+        copy_statistics_t stats;
+        double start;
+        memset(&stats, 0, sizeof(stats));
+        outfile = fopen(output, "w");
+        fseeko(infile, 0, SEEK_SET);
+        start = now();
+        copy_file_data(input.size, infile, outfile, &stats);
+        fclose(outfile);
+        keep_best(&result, now() - start);
+    }
+    result.bytes = input.size;
+    result.tiles = directory.count;
+    report(&result);
+
+    /* process_binfile() end to end */
+    memset(&result, 0, sizeof(result));
+    result.name = "process_binfile";
+    for(run = 0; run < runs; run ++) {
+        double start;
+        FILE * in = fopen(argv[optind], "r");
+        sink.outfile = fopen(output, "w");
+        quiet(1);
+        start = now();
+        process_binfile(in, &sink, 1, NULL, threads, PIPELINE_AUTO, NULL);
+        fclose(sink.outfile);
+        keep_best(&result, now() - start);
+        quiet(0);
+        fclose(in);
+    }
+    result.bytes = input.size;
+    result.tiles = directory.count;
+    report(&result);
+
+    unlink(output);
+    for(i = 0; i < directory.count; i ++)
+        free(names[i]);
+    free(names);
+    free_central_directory(&directory);
+    input_close(&input);
+    fclose(infile);
+    return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Writes a synthetic binfile: tiles named by quadtree paths clustered around
+ * random cities like a real map, filled with NavIT-like items, some of them
+ * empty placeholders, with maptool style local headers and the same zip64
+ * trailer the extractor writes. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <zlib.h>
+
+#include "zipfile.h"
+#include "map.h"
+
+#define MAX_DEPTH 24
+#define CITIES 64
+
+typedef struct tile_name tile_name_t;
+struct tile_name {
+    char name[MAX_DEPTH +1];
+};
+
+enum size_distribution {
+    SIZE_FIXED,
+    SIZE_UNIFORM,
+    SIZE_LOGNORMAL
+};
+
+typedef struct generator_parameters generator_parameters_t;
+struct generator_parameters {
+    uint64_t tiles;
+    int depth;
+    double empty;
+    int level;
+    enum size_distribution distribution;
+    double size_a;
+    double size_b;
+};
+
+static void usage (void) {
+    fprintf(stderr,"\n"
+            " usage: navit_binfile_generator [options] > <binfile>\n"
+            "\n"
+            " Options\n"
+            "  -n <tiles>      number of tiles (100000)\n"
+            "  -d <depth>      deepest tile (14)\n"
+            "  -e <fraction>   empty placeholder tiles (0.1)\n"
+            "  -c <level>      deflate tiles with this zlib level, 0 stores them (1)\n"
+            "  -z <sizes>      uncompressed tile sizes: fixed:<bytes>,\n"
+            "                  uniform:<min>:<max> or lognormal:<median>:<sigma>\n"
+            "                  (lognormal:4096:1.5)\n"
+            "  -s <seed>       random seed (1)\n"
+            "  -o <file>       write here instead of stdout\n"
+            "\n");
+}
+
+static double random_uniform(void) {
+    return (random() + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+static double random_normal(void) {
+    return sqrt(-2 * log(random_uniform())) * cos(2 * M_PI * random_uniform());
+}
+
+static uint64_t random_size(generator_parameters_t * p) {
+    double size;
+    switch(p->distribution) {
+    case SIZE_UNIFORM:
+        size = p->size_a + (p->size_b - p->size_a) * random_uniform();
+        break;
+    case SIZE_LOGNORMAL:
+        size = p->size_a * exp(p->size_b * random_normal());
+        break;
+    default:
+        size = p->size_a;
+        break;
+    }
+    if(size < 16)
+        size = 16;
+    return (uint64_t)size & ~3;
+}
+
+/* path of the tile at depth containing c, as tile_bbox() cuts the world */
+static void tile_path(struct coord * c, int depth, char * name) {
+    struct rect r;
+    int i;
+    tile_bbox("", &r, 0);
+    for(i = 0; i < depth; i ++) {
+        int x = (r.l.x + r.h.x) / 2;
+        int y = (r.l.y + r.h.y) / 2;
+        if(c->x >= x) {
+            name[i] = (c->y >= y) ? 'a' : 'c';
+            r.l.x = x;
+        } else {
+            name[i] = (c->y >= y) ? 'b' : 'd';
+            r.h.x = x;
+        }
+        if(c->y >= y)
+            r.l.y = y;
+        else
+            r.h.y = y;
+    }
+    name[depth] = 0;
+}
+
+static int compare_names(const void * a, const void * b) {
+    return strcmp(((tile_name_t *)a)->name, ((tile_name_t *)b)->name);
+}
+
+/* most tiles are deep ones near cities, a few cover whole countries */
+static tile_name_t * make_names(generator_parameters_t * p, uint64_t * count) {
+    struct coord cities[CITIES];
+    struct rect world;
+    tile_name_t * names = malloc(p->tiles * sizeof(tile_name_t));
+    uint64_t used = 0;
+    int i;
+
+    tile_bbox("", &world, 0);
+    for(i = 0; i < CITIES; i ++) {
+        cities[i].x = world.l.x + (world.h.x - world.l.x) * random_uniform() * 0.9;
+        cities[i].y = world.l.y + (world.h.y - world.l.y) * (0.3 + 0.5 * random_uniform());
+    }
+    while(used < p->tiles) {
+        uint64_t i;
+        uint64_t kept;
+        for(i = used; i < p->tiles; i ++) {
+            struct coord * city = &(cities[random() % CITIES]);
+            struct coord c;
+            double spread = (world.h.x - world.l.x) / 64.0 * fabs(random_normal());
+            int depth = p->depth - (int)(fabs(random_normal()) * p->depth / 3);
+            double angle = 2 * M_PI * random_uniform();
+            if(depth < 1)
+                depth = 1;
+            c.x = city->x + spread * cos(angle);
+            c.y = city->y + spread * sin(angle);
+            tile_path(&c, depth, names[i].name);
+        }
+        qsort(names, p->tiles, sizeof(tile_name_t), compare_names);
+        for(i = 1, kept = 1; i < p->tiles; i ++)
+            if(strcmp(names[i].name, names[kept -1].name) != 0)
+                names[kept ++] = names[i];
+        used = kept;
+    }
+    *count = used;
+    return names;
+}
+
+/* items: length of the rest, type, coordinate ints, coordinates, one attribute */
+static uint64_t make_items(char * name, uint64_t size, int32_t * data) {
+    struct rect r;
+    uint64_t used = 0;
+    uint64_t count = size / sizeof(int32_t);
+    tile_bbox(name, &r, 0);
+    while(used + 8 <= count) {
+        int coords = 2 * (1 + random() % 16);
+        int i;
+        if(used + 6 + coords > count)
+            coords = 2;
+        data[used] = 2 + coords + 3;
+        data[used +1] = (random() % 3 == 0) ? 0x80000001 + random() % 0x100 : 0x00010000 + random() % 0x100;
+        data[used +2] = coords;
+        /* ways wander off from a random start, in small steps */
+        data[used +3] = r.l.x + (int64_t)(r.h.x - r.l.x) * random() / RAND_MAX;
+        data[used +4] = r.l.y + (int64_t)(r.h.y - r.l.y) * random() / RAND_MAX;
+        for(i = 2; i < coords; i += 2) {
+            data[used +3 +i] = data[used +1 +i] + (int)(((r.h.x - r.l.x) >> 6) * (random_uniform() - 0.5));
+            data[used +4 +i] = data[used +2 +i] + (int)(((r.h.y - r.l.y) >> 6) * (random_uniform() - 0.5));
+        }
+        data[used +3 +coords] = 2;
+        data[used +4 +coords] = 0x00010002;
+        data[used +5 +coords] = random() % 1024;
+        used += 6 + coords;
+    }
+    return used * sizeof(int32_t);
+}
+
+static uint64_t write_tile(generator_parameters_t * p, char * name, uint64_t offset,
+                           local_file_header_storage_t * storage, FILE * outfile) {
+    local_file_header_t * header;
+    uint16_t length = strlen(name);
+    char * raw = NULL;
+    char * data = NULL;
+    uint64_t raw_size = 0;
+    uint64_t size = 0;
+
+    header = storage_add_header(storage, sizeof(*header) + length);
+    memset(header, 0, sizeof(*header));
+    header->local_file_header_signature = LOCAL_FILE_HEADER_SIGNATURE;
+    header->version_needed_to_extract = 0x000a;
+    header->last_mod_file_time = 0x6000;
+    header->last_mod_file_date = 0x4e21;
+    header->file_name_length = length;
+    memcpy(header +1, name, length);
+
+    if((strcmp(name, "index") == 0) || (random_uniform() >= p->empty)) {
+        raw_size = random_size(p);
+        raw = malloc(raw_size);
+        raw_size = make_items(name, raw_size, (int32_t *)raw);
+        data = raw;
+        size = raw_size;
+        header->crc32 = crc32(0, (Bytef *)raw, raw_size);
+        if(p->level > 0) {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            deflateInit2(&stream, p->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            data = malloc(deflateBound(&stream, raw_size));
+            stream.next_in = (Bytef *)raw;
+            stream.avail_in = raw_size;
+            stream.next_out = (Bytef *)data;
+            stream.avail_out = deflateBound(&stream, raw_size);
+            deflate(&stream, Z_FINISH);
+            size = stream.total_out;
+            deflateEnd(&stream);
+            header->compressionmethod = 8;
+        }
+    }
+    header->compressed_size = size;
+    header->uncompressed_size = raw_size;
+    fwrite(header, sizeof(*header) + length, 1, outfile);
+    if(size > 0)
+        fwrite(data, size, 1, outfile);
+    remember_local_file(storage, header, offset);
+    if(data != raw)
+        free(data);
+    if(raw != NULL)
+        free(raw);
+    return sizeof(*header) + length + size;
+}
+
+static int parse_sizes(char * value, generator_parameters_t * p) {
+    if(sscanf(value, "fixed:%lf", &p->size_a) == 1)
+        p->distribution = SIZE_FIXED;
+    else if(sscanf(value, "uniform:%lf:%lf", &p->size_a, &p->size_b) == 2)
+        p->distribution = SIZE_UNIFORM;
+    else if(sscanf(value, "lognormal:%lf:%lf", &p->size_a, &p->size_b) == 2)
+        p->distribution = SIZE_LOGNORMAL;
+    else
+        return -1;
+    return 0;
+}
+
+int main (int argc, char ** argv) {
+    generator_parameters_t p;
+    local_file_header_storage_t storage;
+    FILE * outfile = stdout;
+    tile_name_t * names;
+    uint64_t count;
+    uint64_t offset = 0;
+    uint64_t central_directory_size;
+    uint64_t i;
+    int c;
+
+    memset(&p, 0, sizeof(p));
+    p.tiles = 100000;
+    p.depth = 14;
+    p.empty = 0.1;
+    p.level = 1;
+    p.distribution = SIZE_LOGNORMAL;
+    p.size_a = 4096;
+    p.size_b = 1.5;
+    srandom(1);
+    while((c = getopt(argc, argv, "n:d:e:c:z:s:o:h")) != -1) {
+        switch(c) {
+        case 'n':
+            p.tiles = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            p.depth = atoi(optarg);
+            break;
+        case 'e':
+            p.empty = atof(optarg);
+            break;
+        case 'c':
+            p.level = atoi(optarg);
+            break;
+        case 'z':
+            if(parse_sizes(optarg, &p) != 0) {
+                usage();
+                exit(1);
+            }
+            break;
+        case 's':
+            srandom(atoi(optarg));
+            break;
+        case 'o':
+            outfile = fopen(optarg, "w");
+            if(outfile == NULL) {
+                fprintf(stderr, "ERROR opening %s: %s\n", optarg, strerror(errno));
+                exit(1);
+            }
+            break;
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if((optind != argc) || (p.tiles < 1) || (p.depth < 1) || (p.depth > MAX_DEPTH) || (p.level < 0) || (p.level > 9)) {
+        usage();
+        exit(1);
+    }
+    if(isatty(fileno(outfile))) {
+        fprintf(stderr, "ERROR not writing a binfile to a terminal\n");
+        exit(1);
+    }
+
+    names = make_names(&p, &count);
+    memset(&storage, 0, sizeof(storage));
+    /* maptool puts the index first */
+    offset += write_tile(&p, "index", offset, &storage, outfile);
+    for(i = 0; i < count; i ++)
+        offset += write_tile(&p, names[i].name, offset, &storage, outfile);
+    central_directory_size = write_central_directory(&storage, outfile);
+    write_end_of_central_directory(offset + central_directory_size, offset, central_directory_size, &storage, outfile);
+    fprintf(stderr, "generated %ld tiles, %ld bytes of tile data\n", storage.count, offset);
+    free_storage(&storage);
+    free(names);
+    if(fclose(outfile) != 0) {
+        fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __navitextract_h
+#define __navitextract_h
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define NAVIT_EXTRACT_API __attribute__((visibility("default")))
+#else
+#define NAVIT_EXTRACT_API
+#endif
+
+/* libnavitextract: extract areas of a Navit binfile inside another program.
+ *
+ * A navit_extract_t holds all there is to one run: one input, any number of
+ * outputs each with its own area, and the statistics. Nothing is shared
+ * between handles, so extractions may run in as many threads at once as
+ * there are handles. Calls on the same handle must not overlap.
+ *
+ * Functions returning int give 0 (or an output number) on success and -1 on
+ * failure, with a message on stderr. The library never exits the process. */
+typedef struct navit_extract navit_extract_t;
+
+/* same contract as read(2) and write(2): bytes moved, 0 at the end of the
+ * input, -1 on errors */
+typedef ssize_t (*navit_extract_read_t)(void * context, char * buffer, size_t size);
+typedef ssize_t (*navit_extract_write_t)(void * context, const char * data, size_t size);
+
+typedef struct navit_extract_stats navit_extract_stats_t;
+struct navit_extract_stats {
+    uint64_t bytes_read;
+    uint64_t bytes_skipped;
+    uint64_t bytes_written;      /* over all outputs */
+    uint64_t tiles_kept;         /* tiles with data in at least one output */
+    uint64_t tiles_placeholder;  /* tiles written as empty entries only */
+    uint64_t tiles_dropped;
+};
+
+NAVIT_EXTRACT_API navit_extract_t * navit_extract_new(void);
+NAVIT_EXTRACT_API void navit_extract_free(navit_extract_t * extract);
+
+/* The input. A regular file given as fd is read at random and only where the
+ * outputs need it, anything else is read once from start to end. The fd is
+ * duplicated, the caller keeps its own. */
+NAVIT_EXTRACT_API int navit_extract_set_input_fd(navit_extract_t * extract, int fd);
+NAVIT_EXTRACT_API int navit_extract_set_input_reader(navit_extract_t * extract, navit_extract_read_t read,
+        void * context);
+
+/* Outputs return their number for the area calls. Until it gets an area an
+ * output receives the whole map. */
+NAVIT_EXTRACT_API int navit_extract_add_output_fd(navit_extract_t * extract, int fd);
+NAVIT_EXTRACT_API int navit_extract_add_output_writer(navit_extract_t * extract, navit_extract_write_t write,
+        void * context);
+NAVIT_EXTRACT_API int navit_extract_set_bbox(navit_extract_t * extract, int output,
+        double lon_bottom_left, double lat_bottom_left,
+        double lon_top_right, double lat_top_right);
+/* Osmosis .poly or GeoJSON (multi)polygon, replaces the box */
+NAVIT_EXTRACT_API int navit_extract_set_polygon(navit_extract_t * extract, int output, const char * path);
+/* overview around the area: tiles down to depth touching this box are kept too, depth 0 turns it off */
+NAVIT_EXTRACT_API int navit_extract_set_outer(navit_extract_t * extract, int output,
+        double lon_bottom_left, double lat_bottom_left,
+        double lon_top_right, double lat_top_right, int depth);
+/* clip tiles on the border to the items within margin (mercator units), -1 keeps them whole */
+NAVIT_EXTRACT_API int navit_extract_set_clip(navit_extract_t * extract, int output, int margin);
+/* 1 lets the empty placeholders of rejected tiles share one local file header */
+NAVIT_EXTRACT_API int navit_extract_set_compact(navit_extract_t * extract, int output, int compact);
+/* 1 deflates the kept tiles again with the strongest zlib settings where that makes them smaller */
+NAVIT_EXTRACT_API int navit_extract_set_recompress(navit_extract_t * extract, int output, int recompress);
+
+/* How the run goes: tile index sidecar, threads for copying and clipping,
+ * output backend "auto", "sync", "thread" or "uring". */
+NAVIT_EXTRACT_API int navit_extract_set_index(navit_extract_t * extract, const char * path);
+NAVIT_EXTRACT_API int navit_extract_set_threads(navit_extract_t * extract, int threads);
+NAVIT_EXTRACT_API int navit_extract_set_io(navit_extract_t * extract, const char * backend);
+/* 0 is quiet, 1 reports progress on stderr like the command line tool */
+NAVIT_EXTRACT_API int navit_extract_set_verbose(navit_extract_t * extract, int verbose);
+/* 1 checks the CRC of every kept tile, the run fails if one is wrong */
+NAVIT_EXTRACT_API int navit_extract_set_verify(navit_extract_t * extract, int verify);
+
+/* Extract all outputs in one pass over the input. All output is flushed when
+ * it returns. A handle runs once. */
+NAVIT_EXTRACT_API int navit_extract_run(navit_extract_t * extract);
+NAVIT_EXTRACT_API int navit_extract_get_stats(navit_extract_t * extract, navit_extract_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
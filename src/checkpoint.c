@@ -0,0 +1,274 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "checkpoint.h"
+
+void checkpoint_init(checkpoint_t * checkpoint, const char * path, uint64_t interval) {
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->path = path;
+    checkpoint->interval = (interval > 0) ? interval : CHECKPOINT_INTERVAL;
+}
+
+/* a checkpoint of other settings would continue into different outputs */
+static uint32_t sink_settings(uint32_t crc, extract_sink_t * sink) {
+    int32_t values[] = {
+        sink->area.l.x, sink->area.l.y, sink->area.h.x, sink->area.h.y,
+        sink->outer.l.x, sink->outer.l.y, sink->outer.h.x, sink->outer.h.y,
+        sink->outer_depth, sink->margin, sink->compact, sink->recompress
+    };
+    int i;
+    crc = crc32(crc, (Bytef *)values, sizeof(values));
+    if(sink->name != NULL)
+        crc = crc32(crc, (Bytef *)sink->name, strlen(sink->name));
+    if(sink->polygon == NULL)
+        return crc;
+    for(i = 0; i < sink->polygon->count; i ++) {
+        struct polygon_ring * ring = &(sink->polygon->rings[i]);
+        int32_t kind[] = {ring->polygon, ring->hole};
+        crc = crc32(crc, (Bytef *)kind, sizeof(kind));
+        crc = crc32(crc, (Bytef *)ring->points, ring->count * sizeof(struct coord));
+    }
+    return crc;
+}
+
+static int write_data(FILE * file, const void * data, uint64_t size) {
+    return (size == 0) || (fwrite(data, size, 1, file) == 1);
+}
+
+static int read_data(FILE * file, void * data, uint64_t size) {
+    return (size == 0) || (fread(data, size, 1, file) == 1);
+}
+
+/* cut the outputs back to what the sinks have written */
+static int cut_outputs(extract_sink_t * sinks, int count) {
+    int i;
+    for(i = 0; i < count; i ++) {
+        if((ftruncate(fileno(sinks[i].outfile), sinks[i].written) != 0)
+                || (fseeko(sinks[i].outfile, sinks[i].written, SEEK_SET) != 0)) {
+            fprintf(stderr, "ERROR preparing output%s%s: %s\n", (sinks[i].name != NULL) ? " " : "",
+                    (sinks[i].name != NULL) ? sinks[i].name : "", strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void forget_sinks(extract_sink_t * sinks, int count) {
+    int i;
+    for(i = 0; i < count; i ++) {
+        free_storage(&(sinks[i].storage));
+        sinks[i].written = 0;
+        sinks[i].placeholder = -1;
+        memset(sinks[i].kept, 0, sizeof(sinks[i].kept));
+        memset(sinks[i].placeholders, 0, sizeof(sinks[i].placeholders));
+    }
+}
+
+static int load_sink(FILE * file, extract_sink_t * sink) {
+    local_file_header_storage_t * storage = &(sink->storage);
+    checkpoint_sink_t saved;
+    struct stat st;
+
+    if(!read_data(file, &saved, sizeof(saved)))
+        return -1;
+    /* the output has to hold everything up to the checkpoint */
+    if((fstat(fileno(sink->outfile), &st) != 0) || (st.st_size < saved.written))
+        return -1;
+    if(saved.header_bytes > 0) {
+        local_file_header_t * headers = storage_add_header(storage, saved.header_bytes);
+        if(!read_data(file, headers, saved.header_bytes))
+            return -1;
+    }
+    storage->count = storage->allocated = saved.count;
+    if(saved.count > 0) {
+        storage->offsets = calloc(saved.count, sizeof(uint64_t));
+        storage->sizes = calloc(saved.count, sizeof(uint64_t));
+        storage->crcs = calloc(saved.count, sizeof(uint32_t));
+        if(!read_data(file, storage->offsets, saved.count * sizeof(uint64_t))
+                || !read_data(file, storage->sizes, saved.count * sizeof(uint64_t))
+                || !read_data(file, storage->crcs, saved.count * sizeof(uint32_t)))
+            return -1;
+    }
+    sink->written = saved.written;
+    sink->placeholder = saved.placeholder;
+    memcpy(sink->kept, saved.kept, sizeof(sink->kept));
+    memcpy(sink->placeholders, saved.placeholders, sizeof(sink->placeholders));
+    return 0;
+}
+
+int checkpoint_load(checkpoint_t * checkpoint, FILE * infile, extract_sink_t * sinks, int count,
+                    run_statistics_t * stats) {
+    checkpoint_header_t header;
+    FILE * file;
+    int i;
+
+    if((fstat(fileno(infile), &(checkpoint->input)) != 0) || !S_ISREG(checkpoint->input.st_mode)) {
+        fprintf(stderr, "ERROR checkpoints need a regular file as input\n");
+        return -1;
+    }
+    checkpoint->settings = crc32(0, (Bytef *)&(checkpoint->interval), sizeof(checkpoint->interval));
+    for(i = 0; i < count; i ++) {
+        struct stat st;
+        if((fstat(fileno(sinks[i].outfile), &st) != 0) || !S_ISREG(st.st_mode)) {
+            fprintf(stderr, "ERROR checkpoints need regular files as outputs\n");
+            return -1;
+        }
+        checkpoint->settings = sink_settings(checkpoint->settings, &(sinks[i]));
+    }
+    checkpoint->entry = 0;
+    checkpoint->next = checkpoint->interval;
+
+    file = fopen(checkpoint->path, "r");
+    if(file == NULL) {
+        if(errno != ENOENT) {
+            fprintf(stderr, "ERROR opening %s: %s\n", checkpoint->path, strerror(errno));
+            return -1;
+        }
+        return (cut_outputs(sinks, count) == 0) ? 0 : -1;
+    }
+    if(!read_data(file, &header, sizeof(header))
+            || (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+            || (header.version != CHECKPOINT_VERSION) || (header.count != (uint32_t)count)
+            || (header.input_size != (uint64_t)checkpoint->input.st_size)
+            || (header.input_mtime_sec != checkpoint->input.st_mtim.tv_sec)
+            || (header.input_mtime_nsec != checkpoint->input.st_mtim.tv_nsec)
+            || (header.settings != checkpoint->settings)) {
+        fprintf(stderr, "%s is not a checkpoint of this run, starting over\n", checkpoint->path);
+        fclose(file);
+        return (cut_outputs(sinks, count) == 0) ? 0 : -1;
+    }
+    for(i = 0; i < count; i ++) {
+        if(load_sink(file, &(sinks[i])) != 0) {
+            fprintf(stderr, "%s doesn't match the outputs, starting over\n", checkpoint->path);
+            fclose(file);
+            forget_sinks(sinks, count);
+            return (cut_outputs(sinks, count) == 0) ? 0 : -1;
+        }
+    }
+    fclose(file);
+    checkpoint->entry = header.entry;
+    checkpoint->next = header.bytes_read + checkpoint->interval;
+    stats->bytes_read = header.bytes_read;
+    stats->crc_mismatches = header.crc_mismatches;
+    memcpy(stats->kept, header.kept, sizeof(stats->kept));
+    memcpy(stats->placeholders, header.placeholders, sizeof(stats->placeholders));
+    memcpy(stats->dropped, header.dropped, sizeof(stats->dropped));
+    if(stats->verbose > 0)
+        fprintf(stderr, "resuming at tile %ld\n", checkpoint->entry);
+    return (cut_outputs(sinks, count) == 0) ? 1 : -1;
+}
+
+static int save_sink(FILE * file, extract_sink_t * sink) {
+    local_file_header_storage_t * storage = &(sink->storage);
+    header_arena_block_t * block;
+    checkpoint_sink_t saved;
+
+    memset(&saved, 0, sizeof(saved));
+    saved.written = sink->written;
+    saved.placeholder = sink->placeholder;
+    saved.count = storage->count;
+    for(block = storage->first; block != NULL; block = block->next)
+        saved.header_bytes += block->used;
+    memcpy(saved.kept, sink->kept, sizeof(saved.kept));
+    memcpy(saved.placeholders, sink->placeholders, sizeof(saved.placeholders));
+    if(!write_data(file, &saved, sizeof(saved)))
+        return -1;
+    /* the headers back to back, they come back as one block */
+    for(block = storage->first; block != NULL; block = block->next)
+        if(!write_data(file, block +1, block->used))
+            return -1;
+    if(!write_data(file, storage->offsets, storage->count * sizeof(uint64_t))
+            || !write_data(file, storage->sizes, storage->count * sizeof(uint64_t))
+            || !write_data(file, storage->crcs, storage->count * sizeof(uint32_t)))
+        return -1;
+    return 0;
+}
+
+int checkpoint_save(checkpoint_t * checkpoint, extract_sink_t * sinks, int count, run_statistics_t * stats) {
+    checkpoint_header_t header;
+    char path[4096];
+    FILE * file;
+    int ret = 0;
+    int i;
+
+    /* the outputs first, a checkpoint must never be ahead of them */
+    for(i = 0; i < count; i ++) {
+        if((fflush(sinks[i].outfile) != 0) || (fdatasync(fileno(sinks[i].outfile)) != 0)) {
+            fprintf(stderr, "ERROR syncing output: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.count = count;
+    header.input_size = checkpoint->input.st_size;
+    header.input_mtime_sec = checkpoint->input.st_mtim.tv_sec;
+    header.input_mtime_nsec = checkpoint->input.st_mtim.tv_nsec;
+    header.settings = checkpoint->settings;
+    header.entry = checkpoint->entry;
+    header.bytes_read = stats->bytes_read;
+    header.crc_mismatches = stats->crc_mismatches;
+    memcpy(header.kept, stats->kept, sizeof(header.kept));
+    memcpy(header.placeholders, stats->placeholders, sizeof(header.placeholders));
+    memcpy(header.dropped, stats->dropped, sizeof(header.dropped));
+
+    /* written next to it and renamed over it, so there always is a whole one */
+    snprintf(path, sizeof(path), "%s.tmp", checkpoint->path);
+    file = fopen(path, "w");
+    if(file == NULL) {
+        fprintf(stderr, "ERROR opening %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if(!write_data(file, &header, sizeof(header)))
+        ret = -1;
+    for(i = 0; (ret == 0) && (i < count); i ++)
+        ret = save_sink(file, &(sinks[i]));
+    if((ret == 0) && ((fflush(file) != 0) || (fsync(fileno(file)) != 0)))
+        ret = -1;
+    if(fclose(file) != 0)
+        ret = -1;
+    if((ret == 0) && (rename(path, checkpoint->path) != 0))
+        ret = -1;
+    if(ret != 0) {
+        fprintf(stderr, "ERROR writing %s: %s\n", checkpoint->path, strerror(errno));
+        unlink(path);
+        return -1;
+    }
+    checkpoint->next = stats->bytes_read + checkpoint->interval;
+    if(stats->verbose > 0)
+        fprintf(stderr, "checkpoint at tile %ld\n", checkpoint->entry);
+    return 0;
+}
+
+void checkpoint_remove(checkpoint_t * checkpoint) {
+    if((unlink(checkpoint->path) != 0) && (errno != ENOENT))
+        fprintf(stderr, "ERROR removing %s: %s\n", checkpoint->path, strerror(errno));
+}
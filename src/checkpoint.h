@@ -0,0 +1,87 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __checkpoint_h
+#define __checkpoint_h
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "extractor.h"
+
+/* Long runs from a regular file into regular files can be resumed. Every
+ * interval bytes of tile data read, all results so far are written out and
+ * synced, then the header storage and offsets of every sink go to the
+ * checkpoint file together with the directory entry to go on with. A
+ * restarted run with the same input and settings cuts the outputs back to
+ * that state and continues there. The outputs come out the same as without
+ * the interruption. */
+#define CHECKPOINT_MAGIC "NAVITCKP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_INTERVAL (256*1024*1024)
+
+typedef struct checkpoint checkpoint_t;
+struct checkpoint {
+    const char * path;
+    uint64_t interval;
+    uint64_t next;          /* stats bytes_read at which the next one is due */
+    uint64_t entry;         /* first index entry not done */
+    struct stat input;
+    uint32_t settings;      /* crc of everything that shapes the outputs */
+};
+
+typedef struct checkpoint_header checkpoint_header_t;
+struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;         /* sinks */
+    uint64_t input_size;
+    int64_t input_mtime_sec;
+    int64_t input_mtime_nsec;
+    uint32_t settings;
+    uint32_t reserved;
+    uint64_t entry;
+    uint64_t bytes_read;
+    uint64_t crc_mismatches;
+    uint64_t kept[STATS_DEPTHS];
+    uint64_t placeholders[STATS_DEPTHS];
+    uint64_t dropped[STATS_DEPTHS];
+};
+
+/* followed by header_bytes of local file headers, then count offsets, sizes and crcs */
+typedef struct checkpoint_sink checkpoint_sink_t;
+struct checkpoint_sink {
+    int64_t written;
+    int64_t placeholder;
+    uint64_t count;
+    uint64_t header_bytes;
+    uint64_t kept[STATS_DEPTHS];
+    uint64_t placeholders[STATS_DEPTHS];
+};
+
+void checkpoint_init(checkpoint_t * checkpoint, const char * path, uint64_t interval);
+/* 1 and the sinks restored if there is a checkpoint of this run, 0 to start
+ * from the beginning, -1 on errors */
+int checkpoint_load(checkpoint_t * checkpoint, FILE * infile, extract_sink_t * sinks, int count,
+                    run_statistics_t * stats);
+/* the outputs have to be flushed and synced up to written */
+int checkpoint_save(checkpoint_t * checkpoint, extract_sink_t * sinks, int count, run_statistics_t * stats);
+void checkpoint_remove(checkpoint_t * checkpoint);
+#endif
@@ -0,0 +1,351 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "clip.h"
+
+/* compression methods of the zip spec we can rewrite */
+#define METHOD_STORED 0
+#define METHOD_DEFLATED 8
+
+int clip_supported(local_file_header_t * header) {
+    return (header->compressionmethod == METHOD_STORED) || (header->compressionmethod == METHOD_DEFLATED);
+}
+
+int clip_deflated(local_file_header_t * header) {
+    return header->compressionmethod == METHOD_DEFLATED;
+}
+
+clip_data_t * clip_data_new(char * data, uint64_t size, int copy) {
+    clip_data_t * shared = calloc(1, sizeof(*shared));
+    shared->size = size;
+    shared->owned = copy;
+    shared->references = 1; /* the caller's, given back with clip_data_release() */
+    if(copy) {
+        shared->data = malloc(size);
+        memcpy(shared->data, data, size);
+    } else
+        shared->data = data;
+    return shared;
+}
+
+void clip_data_release(clip_data_t * shared) {
+    if(__atomic_sub_fetch(&(shared->references), 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    if(shared->owned)
+        free(shared->data);
+    free(shared);
+}
+
+/* raw deflate stream as found in zip files */
+static char * inflate_tile(char * data, uint64_t size, uint64_t * inflated) {
+    z_stream stream;
+    uint64_t allocated = size * 4 + 1024;
+    char * buffer = malloc(allocated);
+    int ret;
+
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        free(buffer);
+        return NULL;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    do {
+        if(stream.total_out == allocated) {
+            allocated *= 2;
+            buffer = realloc(buffer, allocated);
+        }
+        stream.next_out = (Bytef *)buffer + stream.total_out;
+        stream.avail_out = allocated - stream.total_out;
+        ret = inflate(&stream, Z_NO_FLUSH);
+    } while(ret == Z_OK);
+    *inflated = stream.total_out;
+    inflateEnd(&stream);
+    if(ret != Z_STREAM_END) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+static char * deflate_tile(char * data, uint64_t size, uint64_t * deflated, int memory, int strategy) {
+    z_stream stream;
+    uint64_t allocated;
+    char * buffer;
+
+    memset(&stream, 0, sizeof(stream));
+    if(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, memory, strategy) != Z_OK)
+        return NULL;
+    allocated = deflateBound(&stream, size);
+    buffer = malloc(allocated);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef *)buffer;
+    stream.avail_out = allocated;
+    if(deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&stream);
+        free(buffer);
+        return NULL;
+    }
+    *deflated = stream.total_out;
+    deflateEnd(&stream);
+    return buffer;
+}
+
+/* the smallest zlib gets: most memory for its hash chains, and the item
+ * arrays are sometimes better Huffman coded with fewer string matches */
+static char * deflate_tile_best(char * data, uint64_t size, uint64_t * deflated) {
+    uint64_t filtered_size;
+    char * filtered;
+    char * buffer = deflate_tile(data, size, deflated, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if(buffer == NULL)
+        return NULL;
+    filtered = deflate_tile(data, size, &filtered_size, MAX_MEM_LEVEL, Z_FILTERED);
+    if((filtered == NULL) || (filtered_size >= *deflated)) {
+        free(filtered);
+        return buffer;
+    }
+    free(buffer);
+    *deflated = filtered_size;
+    return filtered;
+}
+
+/* keep an item if its bounding box, grown by the margin, touches the area */
+static int item_inside(int32_t * coords, int count, struct rect * area, struct polygon_area * polygon, int margin) {
+    struct rect bbox;
+    int i;
+    bbox.l.x = bbox.h.x = coords[0];
+    bbox.l.y = bbox.h.y = coords[1];
+    for(i = 2; i < count; i += 2) {
+        if(coords[i] < bbox.l.x)
+            bbox.l.x = coords[i];
+        if(coords[i] > bbox.h.x)
+            bbox.h.x = coords[i];
+        if(coords[i +1] < bbox.l.y)
+            bbox.l.y = coords[i +1];
+        if(coords[i +1] > bbox.h.y)
+            bbox.h.y = coords[i +1];
+    }
+    bbox.l.x = (bbox.l.x < INT32_MIN + margin) ? INT32_MIN : bbox.l.x - margin;
+    bbox.l.y = (bbox.l.y < INT32_MIN + margin) ? INT32_MIN : bbox.l.y - margin;
+    bbox.h.x = (bbox.h.x > INT32_MAX - margin) ? INT32_MAX : bbox.h.x + margin;
+    bbox.h.y = (bbox.h.y > INT32_MAX - margin) ? INT32_MAX : bbox.h.y + margin;
+    if(!itembin_bbox_intersects(area, &bbox))
+        return 0;
+    return (polygon == NULL) || polygon_area_intersects(polygon, &bbox);
+}
+
+/* Items are int32 arrays: length of the rest, type, number of coordinate
+ * ints, the coordinates, then attributes. Compact the kept ones in place and
+ * return their size, or -1 if this doesn't look like items. */
+static int64_t drop_items(clip_job_t * job, char * data, uint64_t size) {
+    int32_t * item = (int32_t *)data;
+    uint64_t count = size / sizeof(int32_t);
+    uint64_t position = 0;
+    uint64_t kept = 0;
+
+    if(size % sizeof(int32_t) != 0)
+        return -1;
+    while(position < count) {
+        int32_t length = item[position];
+        int32_t coords;
+        if((length < 2) || ((uint64_t)length >= count - position))
+            return -1;
+        coords = item[position +2];
+        if((coords < 0) || (coords > length -2) || (coords & 1))
+            return -1;
+        job->items ++;
+        /* items without coordinates say something about the whole tile */
+        if((coords == 0) || item_inside(item + position +3, coords, &(job->area), job->polygon, job->margin)) {
+            memmove(item + kept, item + position, (length +1) * sizeof(int32_t));
+            kept += length +1;
+        } else
+            job->dropped ++;
+        position += length +1;
+    }
+    return kept * sizeof(int32_t);
+}
+
+static void clip_job_run(clip_job_t * job) {
+    char * raw;
+    uint64_t raw_size;
+    int64_t kept;
+
+    if(job->compression_method == METHOD_DEFLATED)
+        raw = inflate_tile(job->input->data, job->input->size, &raw_size);
+    else {
+        raw_size = job->input->size;
+        raw = malloc(raw_size);
+        memcpy(raw, job->input->data, raw_size);
+    }
+    if(raw == NULL) {
+        fprintf(stderr, "ERROR inflating tile, copying it whole\n");
+        return;
+    }
+    kept = (job->margin >= 0) ? drop_items(job, raw, raw_size) : (int64_t)raw_size;
+    if((kept < 0) || ((job->dropped == 0) && !(job->recompress && (job->compression_method == METHOD_DEFLATED)))) {
+        free(raw);
+        return;
+    }
+    job->uncompressed_size = kept;
+    job->crc32 = (kept > 0) ? crc32(0, (Bytef *)raw, kept) : 0;
+    if(kept == 0) {
+        job->data = NULL;
+        job->size = 0;
+        free(raw);
+    } else if(job->compression_method == METHOD_DEFLATED) {
+        if(job->recompress)
+            job->data = deflate_tile_best(raw, kept, &(job->size));
+        else
+            job->data = deflate_tile(raw, kept, &(job->size), 8, Z_DEFAULT_STRATEGY);
+        free(raw);
+        if(job->data == NULL)
+            return;
+        if((job->dropped == 0) && (job->size >= job->input->size)) {
+            /* the tile was packed as well already */
+            free(job->data);
+            job->data = NULL;
+            return;
+        }
+    } else {
+        job->data = raw;
+        job->size = kept;
+    }
+    job->clipped = 1;
+    /* the original data isn't needed any more */
+    clip_data_release(job->input);
+    job->input = NULL;
+}
+
+static void * clip_worker(void * data) {
+    clip_pool_t * pool = data;
+    pthread_mutex_lock(&(pool->lock));
+    for(;;) {
+        clip_job_t * job;
+        while((pool->pending == NULL) && !pool->stop)
+            pthread_cond_wait(&(pool->work), &(pool->lock));
+        job = pool->pending;
+        if(job == NULL)
+            break;
+        pool->pending = job->next;
+        pthread_mutex_unlock(&(pool->lock));
+        clip_job_run(job);
+        pthread_mutex_lock(&(pool->lock));
+        job->done = 1;
+        pthread_cond_broadcast(&(pool->done));
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    return NULL;
+}
+
+int clip_pool_start(clip_pool_t * pool, int threads) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&(pool->lock), NULL);
+    pthread_cond_init(&(pool->work), NULL);
+    pthread_cond_init(&(pool->done), NULL);
+    pool->threads = calloc(threads, sizeof(pthread_t));
+    for(pool->count = 0; pool->count < threads; pool->count ++)
+        if(pthread_create(&(pool->threads[pool->count]), NULL, clip_worker, pool) != 0)
+            break;
+    return pool->count;
+}
+
+void clip_pool_submit(clip_pool_t * pool, clip_job_t * job) {
+    __atomic_add_fetch(&(job->input->references), 1, __ATOMIC_RELAXED);
+    job->next = NULL;
+    job->input_size = job->input->size;
+    pthread_mutex_lock(&(pool->lock));
+    pool->backlog += job->input_size;
+    if(pool->last != NULL)
+        pool->last->next = job;
+    else
+        pool->first = job;
+    pool->last = job;
+    if(pool->pending == NULL)
+        pool->pending = job;
+    pthread_cond_signal(&(pool->work));
+    pthread_mutex_unlock(&(pool->lock));
+    if(pool->count == 0) {
+        /* no threads to be had, do it ourselves */
+        pool->pending = NULL;
+        clip_job_run(job);
+        job->done = 1;
+    }
+}
+
+clip_job_t * clip_pool_take(clip_pool_t * pool) {
+    clip_job_t * job;
+    pthread_mutex_lock(&(pool->lock));
+    while((pool->first != NULL) && !pool->first->done)
+        pthread_cond_wait(&(pool->done), &(pool->lock));
+    job = pool->first;
+    if(job != NULL) {
+        pool->first = job->next;
+        if(pool->first == NULL)
+            pool->last = NULL;
+        pool->backlog -= job->input_size;
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    return job;
+}
+
+void clip_job_free(clip_job_t * job) {
+    if(job->input != NULL)
+        clip_data_release(job->input);
+    if(job->data != NULL)
+        free(job->data);
+    free(job);
+}
+
+/* wait until every job is done */
+void clip_pool_finish(clip_pool_t * pool) {
+    int i;
+    pthread_mutex_lock(&(pool->lock));
+    pool->stop = 1;
+    pthread_cond_broadcast(&(pool->work));
+    pthread_mutex_unlock(&(pool->lock));
+    for(i = 0; i < pool->count; i ++)
+        pthread_join(pool->threads[i], NULL);
+    pool->count = 0;
+}
+
+void clip_pool_free(clip_pool_t * pool) {
+    clip_job_t * job = pool->first;
+    clip_pool_finish(pool);
+    while(job != NULL) {
+        clip_job_t * next = job->next;
+        clip_job_free(job);
+        job = next;
+    }
+    if(pool->threads != NULL)
+        free(pool->threads);
+    pthread_mutex_destroy(&(pool->lock));
+    pthread_cond_destroy(&(pool->work));
+    pthread_cond_destroy(&(pool->done));
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,96 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __clip_h
+#define __clip_h
+#include <stdint.h>
+#include <pthread.h>
+
+#include "zipfile.h"
+#include "map.h"
+
+/* Tiles on the border of an area are inflated, stripped of the items lying
+ * completely outside the area plus a margin and deflated again. Clipping runs
+ * on a pool of threads while the input keeps streaming. The results are
+ * collected in submission order, so the output doesn't depend on timing.
+ * Recompressing a tile is clipping it without dropping anything. */
+
+/* input bytes of the jobs not taken yet, beyond this the results are written
+ * while the input is still read */
+#define CLIP_BACKLOG (64*1024*1024)
+
+/* compressed tile data, shared by the jobs of all sinks clipping the tile */
+typedef struct clip_data clip_data_t;
+struct clip_data {
+    char * data;
+    uint64_t size;
+    int owned;      /* data is a private copy, not a view of the input map */
+    int references;
+};
+
+typedef struct clip_job clip_job_t;
+struct clip_job {
+    clip_job_t * next;
+    clip_data_t * input;
+    uint16_t compression_method;
+    struct rect area;
+    struct polygon_area * polygon;
+    int margin;                 /* -1 keeps all items */
+    int recompress;             /* deflate again even if nothing is dropped, if that is smaller */
+    void * owner;               /* who gets the result */
+    local_file_header_t * header;
+    uint64_t slot;              /* of the header in the owner's storage */
+    uint64_t input_size;
+    int done;
+    int clipped;                /* 0: use the input data unchanged */
+    char * data;
+    uint64_t size;
+    uint64_t uncompressed_size;
+    uint32_t crc32;
+    uint64_t items;
+    uint64_t dropped;
+};
+
+typedef struct clip_pool clip_pool_t;
+struct clip_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    pthread_t * threads;
+    int count;
+    int stop;
+    clip_job_t * first;
+    clip_job_t * last;
+    clip_job_t * pending;       /* next job nobody works on yet */
+    uint64_t backlog;           /* input bytes of the jobs not taken */
+};
+
+int clip_supported(local_file_header_t * header);
+int clip_deflated(local_file_header_t * header);
+clip_data_t * clip_data_new(char * data, uint64_t size, int copy);
+void clip_data_release(clip_data_t * shared);
+int clip_pool_start(clip_pool_t * pool, int threads);
+void clip_pool_submit(clip_pool_t * pool, clip_job_t * job);
+/* the oldest job once it is done, NULL if there is none */
+clip_job_t * clip_pool_take(clip_pool_t * pool);
+void clip_job_free(clip_job_t * job);
+void clip_pool_finish(clip_pool_t * pool);
+void clip_pool_free(clip_pool_t * pool);
+#endif
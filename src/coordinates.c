@@ -32,35 +32,65 @@ struct rect world_bbox = {
     { WORLD_BOUNDINGBOX_MAX_X, WORLD_BOUNDINGBOX_MAX_Y},
 };
 
-void tile_bbox(char *tile, struct rect *r, int overlap) {
+/* one quadtree level down, other characters leave the rect as it is */
+void tile_step(struct rect *r, char quadrant, int overlap) {
     struct coord c;
     int xo,yo;
+    c.x=(r->l.x+r->h.x)/2;
+    c.y=(r->l.y+r->h.y)/2;
+    xo=(r->h.x-r->l.x)*overlap/100;
+    yo=(r->h.y-r->l.y)*overlap/100;
+    switch (quadrant) {
+    case 'a':
+        r->l.x=c.x-xo;
+        r->l.y=c.y-yo;
+        break;
+    case 'b':
+        r->h.x=c.x+xo;
+        r->l.y=c.y-yo;
+        break;
+    case 'c':
+        r->l.x=c.x-xo;
+        r->h.y=c.y+yo;
+        break;
+    case 'd':
+        r->h.x=c.x+xo;
+        r->h.y=c.y+yo;
+        break;
+    }
+}
+
+void tile_bbox(char *tile, struct rect *r, int overlap) {
     *r=world_bbox;
     while (*tile) {
-        c.x=(r->l.x+r->h.x)/2;
-        c.y=(r->l.y+r->h.y)/2;
-        xo=(r->h.x-r->l.x)*overlap/100;
-        yo=(r->h.y-r->l.y)*overlap/100;
-        switch (*tile) {
-        case 'a':
-            r->l.x=c.x-xo;
-            r->l.y=c.y-yo;
-            break;
-        case 'b':
-            r->h.x=c.x+xo;
-            r->l.y=c.y-yo;
-            break;
-        case 'c':
-            r->l.x=c.x-xo;
-            r->h.y=c.y+yo;
-            break;
-        case 'd':
-            r->h.x=c.x+xo;
-            r->h.y=c.y+yo;
-            break;
+        tile_step(r, *tile, overlap);
+        tile++;
+    }
+}
+
+void tile_walk_init(tile_walk_t *walk, int overlap) {
+    walk->rects[0]=world_bbox;
+    walk->length=0;
+    walk->overlap=overlap;
+}
+
+/* Binfiles list the tiles depth first, so a name mostly shares all but its
+ * last letters with the one before. Only the rest is cut down again. */
+void tile_walk_bbox(tile_walk_t *walk, char *tile, struct rect *r) {
+    int depth=0;
+    while ((depth < walk->length) && (tile[depth] == walk->path[depth]))
+        depth++;
+    *r=walk->rects[depth];
+    tile+=depth;
+    while (*tile) {
+        tile_step(r, *tile, walk->overlap);
+        if (depth < TILE_WALK_DEPTH) {
+            walk->path[depth]=*tile;
+            walk->rects[++depth]=*r;
         }
         tile++;
     }
+    walk->length=depth;
 }
 
 int tile_len(char *tile) {
@@ -105,3 +135,8 @@ void getmercator(double sx,double sy, double ex, double ey, struct rect * bbox)
     bbox->h.x=round(ex);
     bbox->h.y=round(ey);
 }
+
+void getmercator_coord(double lon, double lat, struct coord * c) {
+    c->x = round(lon*EARTHR*M_PI/180);
+    c->y = round(log(tan(M_PI_4+lat*M_PI/360))*EARTHR);
+}
@@ -0,0 +1,181 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "copypool.h"
+
+typedef struct copy_worker copy_worker_t;
+struct copy_worker {
+    pthread_t thread;
+    copy_plan_t * plan;
+    uint64_t * next;
+    int failed;
+    copy_statistics_t stats;
+};
+
+void copy_plan_add(copy_plan_t * plan, int in, uint64_t in_offset, int out, uint64_t out_offset, uint64_t size) {
+    while(size > 0) {
+        copy_task_t * task;
+        uint64_t chunk = size;
+        if(chunk > COPY_PLAN_CHUNK)
+            chunk = COPY_PLAN_CHUNK;
+        if(plan->count == plan->allocated) {
+            plan->allocated = (plan->allocated == 0) ? 1024 : plan->allocated * 2;
+            plan->tasks = reallocarray(plan->tasks, plan->allocated, sizeof(copy_task_t));
+        }
+        task = &(plan->tasks[plan->count ++]);
+        task->in = in;
+        task->out = out;
+        task->in_offset = in_offset;
+        task->out_offset = out_offset;
+        task->size = chunk;
+        plan->bytes += chunk;
+        in_offset += chunk;
+        out_offset += chunk;
+        size -= chunk;
+    }
+}
+
+static int copy_task_buffered(copy_task_t * task, uint64_t done, char * buffer) {
+    while(done < task->size) {
+        ssize_t got;
+        ssize_t put;
+        uint64_t chunk = task->size - done;
+        if(chunk > COPY_PLAN_CHUNK)
+            chunk = COPY_PLAN_CHUNK;
+        got = pread(task->in, buffer, chunk, task->in_offset + done);
+        if(got <= 0) {
+            fprintf(stderr, "ERROR reading: %s\n", (got < 0) ? strerror(errno) : "end of file");
+            return -1;
+        }
+        put = pwrite(task->out, buffer, got, task->out_offset + done);
+        if(put != got) {
+            fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+            return -1;
+        }
+        done += got;
+    }
+    return 0;
+}
+
+static void * copy_worker(void * data) {
+    copy_worker_t * worker = data;
+    char * buffer = NULL;
+    for(;;) {
+        uint64_t index = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED);
+        copy_task_t * task;
+        loff_t in_offset;
+        loff_t out_offset;
+        uint64_t done = 0;
+        if(index >= worker->plan->count)
+            break;
+        task = &(worker->plan->tasks[index]);
+        in_offset = task->in_offset;
+        out_offset = task->out_offset;
+        while(done < task->size) {
+            ssize_t copied = copy_file_range(task->in, &in_offset, task->out, &out_offset, task->size - done, 0);
+            if((copied < 0) && (errno == EINTR))
+                continue;
+            if(copied <= 0)
+                break;
+            done += copied;
+        }
+        worker->stats.bytes[COPY_METHOD_COPY_FILE_RANGE] += done;
+        if(done < task->size) {
+            /* whatever the kernel refused goes the classic way */
+            if(buffer == NULL)
+                buffer = malloc(COPY_PLAN_CHUNK);
+            if(copy_task_buffered(task, done, buffer) != 0) {
+                worker->failed = 1;
+                break;
+            }
+            worker->stats.bytes[COPY_METHOD_BUFFERED] += task->size - done;
+        }
+    }
+    if(buffer != NULL)
+        free(buffer);
+    return NULL;
+}
+
+int copy_plan_run(copy_plan_t * plan, int threads, copy_statistics_t * stats) {
+    copy_worker_t * workers;
+    uint64_t next = 0;
+    int failed = 0;
+    int started;
+    int i;
+    int j;
+
+    /* nothing kept had data */
+    if(plan->count == 0)
+        return 0;
+    if((uint64_t)threads > plan->count)
+        threads = plan->count;
+    if(threads < 1)
+        threads = 1;
+    workers = calloc(threads, sizeof(copy_worker_t));
+    if(workers == NULL)
+        return -1;
+    for(started = 0; started < threads; started ++) {
+        workers[started].plan = plan;
+        workers[started].next = &next;
+        if(pthread_create(&(workers[started].thread), NULL, copy_worker, &(workers[started])) != 0)
+            break;
+    }
+    if(started == 0) {
+        /* no threads to be had, do it ourselves */
+        workers[0].plan = plan;
+        workers[0].next = &next;
+        copy_worker(&(workers[0]));
+        started = 1;
+    } else {
+        for(i = 0; i < started; i ++)
+            pthread_join(workers[i].thread, NULL);
+    }
+    for(i = 0; i < started; i ++) {
+        failed |= workers[i].failed;
+        if(stats != NULL)
+            for(j = 0; j < COPY_METHOD_COUNT; j ++)
+                stats->bytes[j] += workers[i].stats.bytes[j];
+    }
+    free(workers);
+    return failed ? -1 : 0;
+}
+
+void copy_plan_free(copy_plan_t * plan) {
+    if(plan->tasks != NULL)
+        free(plan->tasks);
+    memset(plan, 0, sizeof(*plan));
+}
+
+/* reserve the blocks of the holes left for the workers, so they don't fragment the file */
+void preallocate_output(int fd, uint64_t size) {
+    if((fallocate(fd, 0, 0, size) != 0) && (errno != EOPNOTSUPP) && (errno != ENOSYS))
+        fprintf(stderr, "preallocating output failed: %s\n", strerror(errno));
+}
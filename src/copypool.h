@@ -0,0 +1,53 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __copypool_h
+#define __copypool_h
+#include <stdint.h>
+
+#include "zipfile.h"
+
+/* Tile data copies whose place in the output is already known. Headers and
+ * central directory are written first, leaving holes the workers fill with
+ * positioned copies. Large tiles are split so they spread over the workers. */
+#define COPY_PLAN_CHUNK (8*1024*1024)
+
+typedef struct copy_task copy_task_t;
+struct copy_task {
+    int in;
+    int out;
+    uint64_t in_offset;
+    uint64_t out_offset;
+    uint64_t size;
+};
+
+typedef struct copy_plan copy_plan_t;
+struct copy_plan {
+    copy_task_t * tasks;
+    uint64_t count;
+    uint64_t allocated;
+    uint64_t bytes;
+};
+
+void copy_plan_add(copy_plan_t * plan, int in, uint64_t in_offset, int out, uint64_t out_offset, uint64_t size);
+int copy_plan_run(copy_plan_t * plan, int threads, copy_statistics_t * stats);
+void copy_plan_free(copy_plan_t * plan);
+void preallocate_output(int fd, uint64_t size);
+#endif
@@ -0,0 +1,428 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "extractor.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "map.h"
+
+typedef struct daemon_request daemon_request_t;
+struct daemon_request {
+    extract_daemon_t * daemon;
+    served_binfile_t * binfile;
+    int connection;
+};
+
+static void free_binfile(served_binfile_t * binfile) {
+    tile_index_free(&(binfile->index));
+    input_close(&(binfile->input));
+    if(binfile->file != NULL)
+        fclose(binfile->file);
+    free(binfile);
+}
+
+/* map the binfile and index it, from the sidecar if it matches */
+static served_binfile_t * load_binfile(const char * path, const char * index_path) {
+    served_binfile_t * binfile = calloc(1, sizeof(*binfile));
+    central_directory_t directory;
+
+    binfile->references = 1;
+    binfile->file = fopen(path, "r");
+    if((binfile->file == NULL) || (fstat(fileno(binfile->file), &(binfile->st)) != 0)) {
+        fprintf(stderr, "ERROR opening %s: %s\n", path, strerror(errno));
+        free_binfile(binfile);
+        return NULL;
+    }
+    if((input_open(&(binfile->input), binfile->file) != 0) || (binfile->input.map == NULL)) {
+        fprintf(stderr, "ERROR can't map %s\n", path);
+        free_binfile(binfile);
+        return NULL;
+    }
+    if((index_path == NULL) || (tile_index_open(&(binfile->index), index_path, &(binfile->st)) != 0)) {
+        if((read_central_directory(&(binfile->input), &directory) != 0)
+                || (tile_index_from_directory(&(binfile->index), &directory) != 0)) {
+            fprintf(stderr, "ERROR no usable central directory in %s\n", path);
+            free_central_directory(&directory);
+            free_binfile(binfile);
+            return NULL;
+        }
+        free_central_directory(&directory);
+    }
+    /* sorted once, every request only looks at the tiles near its area */
+    tile_index_sort(&(binfile->index));
+    return binfile;
+}
+
+static void release_binfile(extract_daemon_t * daemon, served_binfile_t * binfile) {
+    int references;
+    pthread_mutex_lock(&(daemon->lock));
+    references = -- binfile->references;
+    pthread_mutex_unlock(&(daemon->lock));
+    if(references == 0)
+        free_binfile(binfile);
+}
+
+static int same_file(struct stat * a, struct stat * b) {
+    return (a->st_dev == b->st_dev) && (a->st_ino == b->st_ino) && (a->st_size == b->st_size)
+           && (a->st_mtim.tv_sec == b->st_mtim.tv_sec) && (a->st_mtim.tv_nsec == b->st_mtim.tv_nsec);
+}
+
+typedef struct binfile_reload binfile_reload_t;
+struct binfile_reload {
+    extract_daemon_t * daemon;
+    struct stat st;     /* of the path when the change was seen */
+};
+
+/* load the new binfile on a thread of its own, requests go on with the old one meanwhile */
+static void * reload_binfile(void * data) {
+    binfile_reload_t * reload = data;
+    extract_daemon_t * daemon = reload->daemon;
+    served_binfile_t * binfile = load_binfile(daemon->binfile_path, daemon->index_path);
+    served_binfile_t * old = NULL;
+
+    pthread_mutex_lock(&(daemon->lock));
+    if(binfile != NULL) {
+        old = daemon->current;
+        daemon->current = binfile;
+    } else {
+        /* don't try this one again, only the next */
+        daemon->failed = reload->st;
+    }
+    daemon->loading = 0;
+    pthread_mutex_unlock(&(daemon->lock));
+    if(old != NULL) {
+        release_binfile(daemon, old);
+        fprintf(stderr, "serving new %s, %ld tiles\n", daemon->binfile_path, binfile->index.count);
+    } else
+        fprintf(stderr, "keeping the binfile served so far\n");
+    free(reload);
+    return NULL;
+}
+
+/* serve a new binfile at the path from now on, once it is loaded */
+static void check_binfile(extract_daemon_t * daemon, pthread_attr_t * attributes) {
+    binfile_reload_t * reload;
+    pthread_t thread;
+    struct stat st;
+    int changed;
+
+    if(stat(daemon->binfile_path, &st) != 0)
+        return;
+    pthread_mutex_lock(&(daemon->lock));
+    changed = !daemon->loading && !same_file(&st, &(daemon->current->st)) && !same_file(&st, &(daemon->failed));
+    if(changed)
+        daemon->loading = 1;
+    pthread_mutex_unlock(&(daemon->lock));
+    if(!changed)
+        return;
+    reload = malloc(sizeof(*reload));
+    reload->daemon = daemon;
+    reload->st = st;
+    if(pthread_create(&thread, attributes, reload_binfile, reload) != 0) {
+        fprintf(stderr, "ERROR starting to load %s: %s\n", daemon->binfile_path, strerror(errno));
+        pthread_mutex_lock(&(daemon->lock));
+        daemon->loading = 0;
+        pthread_mutex_unlock(&(daemon->lock));
+        free(reload);
+    }
+}
+
+/* one line, the peer may or may not shut down its side after it */
+static int read_request(int connection, char * line, int size) {
+    int used = 0;
+    while(used < size -1) {
+        ssize_t got = read(connection, line + used, size -1 - used);
+        char * end;
+        if((got < 0) && (errno == EINTR))
+            continue;
+        if(got <= 0)
+            break;
+        used += got;
+        line[used] = 0;
+        end = strchr(line, '\n');
+        if(end != NULL) {
+            *end = 0;
+            return 0;
+        }
+    }
+    line[used] = 0;
+    return (used > 0) ? 0 : -1;
+}
+
+static int parse_request(char * line, extract_sink_t * sink) {
+    double values[5];
+    char * position = line;
+    int count;
+
+    for(count = 0; count < 5; count ++) {
+        char * end;
+        values[count] = strtod(position, &end);
+        if(end == position)
+            break;
+        position = end;
+    }
+    while((*position == ' ') || (*position == '\t') || (*position == '\r'))
+        position ++;
+    if(((count != 4) && (count != 5)) || (*position != 0))
+        return -1;
+    /* the margin comes off the socket, NaN and what an int can't hold are refused */
+    if((count == 5) && !((values[4] >= -1) && (values[4] <= INT_MAX)))
+        return -1;
+    getmercator(values[0], values[1], values[2], values[3], &(sink->area));
+    sink->margin = (count == 5) ? (int)values[4] : -1;
+    return 0;
+}
+
+static void * serve_request(void * data) {
+    daemon_request_t * request = data;
+    extract_daemon_t * daemon = request->daemon;
+    served_binfile_t * binfile = request->binfile;
+    char line[DAEMON_MAX_REQUEST];
+    char path[64];
+    binfile_input_t input;
+    extract_sink_t sink;
+    run_statistics_t stats;
+    daemon_trailer_t trailer;
+    FILE * infile = NULL;
+    FILE * outfile = NULL;
+    int ret;
+
+    memset(&sink, 0, sizeof(sink));
+    if((read_request(request->connection, line, sizeof(line)) != 0) || (parse_request(line, &sink) != 0)) {
+        dprintf(request->connection, "ERROR expected <lon> <lat> <lon> <lat> [<margin>]\n");
+        close(request->connection);
+        goto done;
+    }
+    /* the copies seek, so every request needs its own file description */
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fileno(binfile->file));
+    infile = fopen(path, "r");
+    outfile = fdopen(request->connection, "w");
+    if((infile == NULL) || (outfile == NULL)) {
+        dprintf(request->connection, "ERROR %s\n", strerror(errno));
+        if(outfile != NULL)
+            fclose(outfile);
+        else
+            close(request->connection);
+        goto done;
+    }
+    input_share(&input, &(binfile->input), infile);
+    sink.outfile = outfile;
+    stats_init(&stats, 0, 0);
+    /* kept tiles go from the page cache to the socket with sendfile() */
+    ret = process_binfile_indexed(&input, &(binfile->index), &sink, 1, 1, PIPELINE_SYNC, &stats);
+    trailer.magic = DAEMON_TRAILER_MAGIC;
+    trailer.status = (ret == 0) ? 0 : 1;
+    trailer.length = sink.written;
+    if(fwrite(&trailer, sizeof(trailer), 1, outfile) != 1)
+        ret = 1;
+    if(fclose(outfile) != 0)
+        ret = 1;
+    fprintf(stderr, "request %s: %s, %ld bytes, %ld by sendfile\n", line, (ret == 0) ? "done" : "failed",
+            stats.bytes_written, stats.copy.bytes[COPY_METHOD_SENDFILE]);
+
+done:
+    if(infile != NULL)
+        fclose(infile);
+    release_binfile(daemon, binfile);
+    pthread_mutex_lock(&(daemon->lock));
+    daemon->requests --;
+    pthread_cond_signal(&(daemon->idle));
+    pthread_mutex_unlock(&(daemon->lock));
+    free(request);
+    return NULL;
+}
+
+static int listen_on(const char * socket_path) {
+    struct sockaddr_un address;
+    int listener;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR socket path %s is too long\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener < 0) {
+        fprintf(stderr, "ERROR creating socket: %s\n", strerror(errno));
+        return -1;
+    }
+    /* a socket left behind by an earlier run */
+    unlink(socket_path);
+    if((bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listener, 64) != 0)) {
+        fprintf(stderr, "ERROR listening on %s: %s\n", socket_path, strerror(errno));
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+/* runs until killed */
+int serve_binfile(const char * socket_path, const char * binfile_path, const char * index_path, int max_requests) {
+    extract_daemon_t daemon;
+    pthread_attr_t attributes;
+    int listener;
+
+    memset(&daemon, 0, sizeof(daemon));
+    daemon.binfile_path = binfile_path;
+    daemon.index_path = index_path;
+    daemon.max_requests = (max_requests < 1) ? 1 : max_requests;
+    daemon.current = load_binfile(binfile_path, index_path);
+    if(daemon.current == NULL)
+        return 1;
+    listener = listen_on(socket_path);
+    if(listener < 0) {
+        free_binfile(daemon.current);
+        return 1;
+    }
+    pthread_mutex_init(&(daemon.lock), NULL);
+    pthread_cond_init(&(daemon.idle), NULL);
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    fprintf(stderr, "serving %s, %ld tiles, on %s with up to %d requests at once\n", binfile_path,
+            daemon.current->index.count, socket_path, daemon.max_requests);
+
+    for(;;) {
+        struct pollfd ready = {listener, POLLIN, 0};
+        daemon_request_t * request;
+        pthread_t thread;
+        int connection;
+
+        if(poll(&ready, 1, DAEMON_CHECK_INTERVAL) >= 0)
+            check_binfile(&daemon, &attributes);
+        if(!(ready.revents & POLLIN))
+            continue;
+        /* further clients wait in the listen queue */
+        pthread_mutex_lock(&(daemon.lock));
+        while(daemon.requests >= daemon.max_requests)
+            pthread_cond_wait(&(daemon.idle), &(daemon.lock));
+        pthread_mutex_unlock(&(daemon.lock));
+        connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if(connection < 0)
+            continue;
+        request = malloc(sizeof(*request));
+        request->daemon = &daemon;
+        request->connection = connection;
+        pthread_mutex_lock(&(daemon.lock));
+        request->binfile = daemon.current;
+        request->binfile->references ++;
+        daemon.requests ++;
+        pthread_mutex_unlock(&(daemon.lock));
+        if(pthread_create(&thread, &attributes, serve_request, request) != 0) {
+            fprintf(stderr, "ERROR starting request: %s\n", strerror(errno));
+            /* it cleans up after itself either way */
+            shutdown(connection, SHUT_RDWR);
+            serve_request(request);
+        }
+    }
+    return 0;
+}
+
+/* test client: send the arguments as request, copy the answer to outfile */
+int request_extract(const char * socket_path, char ** arguments, int count, FILE * outfile) {
+    struct sockaddr_un address;
+    char line[DAEMON_MAX_REQUEST];
+    char buffer[65536 + sizeof(daemon_trailer_t)];
+    daemon_trailer_t trailer;
+    uint64_t received = 0;
+    uint64_t held = 0;
+    int connection;
+    int used = 0;
+    int i;
+
+    for(i = 0; i < count; i ++)
+        used += snprintf(line + used, sizeof(line) - used, "%s%s", (i > 0) ? " " : "", arguments[i]);
+    if(used >= (int)sizeof(line) -1) {
+        fprintf(stderr, "ERROR request too long\n");
+        return 1;
+    }
+    line[used ++] = '\n';
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) -1);
+    connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if((connection < 0) || (connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+            || (write(connection, line, used) != used)) {
+        fprintf(stderr, "ERROR talking to %s: %s\n", socket_path, strerror(errno));
+        if(connection >= 0)
+            close(connection);
+        return 1;
+    }
+    shutdown(connection, SHUT_WR);
+    for(;;) {
+        ssize_t got = read(connection, buffer + held, sizeof(buffer) - held);
+        uint64_t data;
+        if((got < 0) && (errno == EINTR))
+            continue;
+        if(got <= 0)
+            break;
+        if((received == 0) && (held == 0) && (got >= 5) && (memcmp(buffer, "ERROR", 5) == 0)) {
+            fwrite(buffer, got, 1, stderr);
+            close(connection);
+            return 1;
+        }
+        held += got;
+        /* the last bytes may be the trailer, keep them back */
+        if(held <= sizeof(trailer))
+            continue;
+        data = held - sizeof(trailer);
+        if(fwrite(buffer, data, 1, outfile) != 1) {
+            fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+            close(connection);
+            return 1;
+        }
+        memmove(buffer, buffer + data, sizeof(trailer));
+        held = sizeof(trailer);
+        received += data;
+    }
+    close(connection);
+    if(held < sizeof(trailer)) {
+        fprintf(stderr, "ERROR answer cut off after %ld bytes\n", received + held);
+        return 1;
+    }
+    memcpy(&trailer, buffer, sizeof(trailer));
+    if((trailer.magic != DAEMON_TRAILER_MAGIC) || (trailer.length != received)) {
+        fprintf(stderr, "ERROR answer cut off, received %ld bytes\n", received);
+        return 1;
+    }
+    if(trailer.status != 0) {
+        fprintf(stderr, "ERROR extraction failed after %ld bytes\n", received);
+        return 1;
+    }
+    fprintf(stderr, "received %ld bytes\n", received);
+    return 0;
+}
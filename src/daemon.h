@@ -0,0 +1,74 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __daemon_h
+#define __daemon_h
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "input.h"
+#include "tileindex.h"
+
+/* Extraction daemon. The binfile stays mapped and indexed, every connection on
+ * the Unix socket is one request:
+ *   <bottom left lon> <bottom left lat> <top right lon> <top right lat> [<clip margin>]\n
+ * answered with the extracted binfile and a daemon_trailer_t, or a line starting
+ * with ERROR. A binfile renamed over the served path is loaded off the accept
+ * loop and replaces it for new requests, the running ones finish on the old one. */
+#define DAEMON_MAX_REQUEST 256
+#define DAEMON_CHECK_INTERVAL 1000 /* ms between looks at the binfile */
+#define DAEMON_TRAILER_MAGIC 0x444e4558 /* "XEND" */
+
+/* behind the binfile, so the client can tell a complete answer from a cut off one */
+typedef struct daemon_trailer daemon_trailer_t;
+struct daemon_trailer {
+    uint32_t magic;
+    uint32_t status;  /* 0 if the extraction went through */
+    uint64_t length;  /* bytes of binfile in front of it */
+};
+
+/* one version of the binfile, freed when the last request on it is done */
+typedef struct served_binfile served_binfile_t;
+struct served_binfile {
+    int references;
+    FILE * file;
+    binfile_input_t input;
+    tile_index_t index;
+    struct stat st;
+};
+
+typedef struct extract_daemon extract_daemon_t;
+struct extract_daemon {
+    const char * binfile_path;
+    const char * index_path;
+    served_binfile_t * current;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    int requests;      /* in flight */
+    int max_requests;
+    int loading;        /* a new binfile is being loaded */
+    struct stat failed; /* version of the binfile that didn't load */
+};
+
+int serve_binfile(const char * socket_path, const char * binfile_path, const char * index_path, int max_requests);
+int request_extract(const char * socket_path, char ** arguments, int count, FILE * outfile);
+#endif
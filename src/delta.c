@@ -0,0 +1,742 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "delta.h"
+#include "zipfile.h"
+#include "input.h"
+
+/* tiles smaller than this are written from the map, larger ones copied by the kernel */
+#define DELTA_KERNEL_COPY (64*1024)
+
+/* a tile of one of the binfiles, located by its local file header */
+typedef struct delta_tile delta_tile_t;
+struct delta_tile {
+    central_directory_header_t * entry;
+    uint64_t number;     /* in archive order */
+    const char * name;   /* in the central directory */
+    uint16_t name_length;
+    uint16_t compression_method;
+    uint32_t crc32;
+    uint64_t offset;     /* of the local file header */
+    uint64_t header_size;
+    uint64_t size;       /* compressed data behind the header */
+};
+
+/* a binfile opened for diffing */
+typedef struct delta_binfile delta_binfile_t;
+struct delta_binfile {
+    binfile_input_t input;
+    central_directory_t directory;
+    delta_tile_t * tiles; /* archive order */
+    uint64_t size;
+    uint32_t directory_crc;
+};
+
+/* the op being built, written once the next tile doesn't extend it */
+typedef struct delta_writer delta_writer_t;
+struct delta_writer {
+    FILE * outfile;
+    FILE * newfile;
+    delta_op_t op;
+    uint64_t next_old;   /* old offset an DELTA_OLD_TILES op continues at */
+    uint64_t new_offset; /* where the bytes of DELTA_NEW_TILES or DELTA_LITERAL start */
+    uint64_t new_size;
+    uint64_t written;
+    int error;
+};
+
+static int open_binfile(delta_binfile_t * binfile, FILE * file, const char * what) {
+    struct stat st;
+    uint64_t i;
+    void * tail;
+
+    memset(binfile, 0, sizeof(*binfile));
+    if((input_open(&(binfile->input), file) != 0) || !binfile->input.seekable || (fstat(fileno(file), &st) != 0)) {
+        fprintf(stderr, "ERROR the %s binfile has to be a regular file\n", what);
+        input_close(&(binfile->input));
+        return -1;
+    }
+    binfile->size = st.st_size;
+    if(read_central_directory(&(binfile->input), &(binfile->directory)) != 0) {
+        fprintf(stderr, "ERROR no usable central directory in the %s binfile\n", what);
+        input_close(&(binfile->input));
+        return -1;
+    }
+    /* the old binfile is recognized by its directory, the tiles don't have to be read */
+    if((input_seek(&(binfile->input), binfile->size - binfile->directory.size) != 0)
+            || ((tail = input_peek(&(binfile->input), binfile->directory.size)) == NULL)) {
+        fprintf(stderr, "ERROR reading the %s binfile\n", what);
+        goto fail;
+    }
+    binfile->directory_crc = crc32(0, tail, binfile->directory.size);
+
+    sort_central_directory(&(binfile->directory));
+    binfile->tiles = calloc(binfile->directory.count, sizeof(delta_tile_t));
+    if(binfile->tiles == NULL)
+        goto fail;
+    for(i = 0; i < binfile->directory.count; i ++) {
+        central_directory_entry_t * entry = &(binfile->directory.entries[i]);
+        delta_tile_t * tile = &(binfile->tiles[i]);
+        local_file_header_t * header;
+
+        if((input_seek(&(binfile->input), entry->offset) != 0)
+                || ((header = input_peek(&(binfile->input), sizeof(*header))) == NULL)
+                || (header->local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)) {
+            fprintf(stderr, "ERROR no local file header at %ld in the %s binfile\n", entry->offset, what);
+            goto fail;
+        }
+        tile->header_size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+        header = input_peek(&(binfile->input), tile->header_size);
+        /* tiles are walked by their local headers when the patch is applied */
+        if((header == NULL) || (get_file_length(header) != entry->compressed_size)) {
+            fprintf(stderr, "ERROR local file header at %ld in the %s binfile doesn't give the size of the tile\n",
+                    entry->offset, what);
+            goto fail;
+        }
+        tile->entry = entry->header;
+        tile->number = i;
+        tile->name = (const char *)(entry->header +1);
+        tile->name_length = entry->header->file_name_length;
+        tile->compression_method = entry->header->compression_method;
+        tile->crc32 = entry->header->crc32;
+        tile->offset = entry->offset;
+        tile->size = entry->compressed_size;
+        if(tile->offset + tile->header_size + tile->size > binfile->size - binfile->directory.size) {
+            fprintf(stderr, "ERROR tile at %ld runs into the central directory of the %s binfile\n", entry->offset,
+                    what);
+            goto fail;
+        }
+    }
+    return 0;
+fail:
+    free(binfile->tiles);
+    free_central_directory(&(binfile->directory));
+    input_close(&(binfile->input));
+    return -1;
+}
+
+static void close_binfile(delta_binfile_t * binfile) {
+    free(binfile->tiles);
+    free_central_directory(&(binfile->directory));
+    input_close(&(binfile->input));
+}
+
+static local_file_header_t * peek_header(delta_binfile_t * binfile, delta_tile_t * tile) {
+    if(input_seek(&(binfile->input), tile->offset) != 0)
+        return NULL;
+    return input_peek(&(binfile->input), tile->header_size);
+}
+
+/* empty tile of a compact binfile, its local file header is the one of the tile before */
+static int shared_tile(delta_binfile_t * binfile, uint64_t i) {
+    return (i > 0) && (binfile->tiles[i].offset == binfile->tiles[i -1].offset) && (binfile->tiles[i].size == 0);
+}
+
+/* the local file header the extractor had for the tile, as far as the directory tells */
+static uint64_t directory_header(delta_tile_t * tile, local_file_header_t * header) {
+    central_directory_header_t * entry = tile->entry;
+    memset(header, 0, sizeof(*header));
+    header->local_file_header_signature = LOCAL_FILE_HEADER_SIGNATURE;
+    header->version_needed_to_extract = entry->version_needed_to_extract;
+    header->general_purpose_bit_flag = entry->general_purpose_bit_flag;
+    header->compressionmethod = entry->compression_method;
+    header->last_mod_file_time = entry->last_mod_file_time;
+    header->last_mod_file_date = entry->last_mod_file_date;
+    header->crc32 = entry->crc32;
+    header->compressed_size = entry->compressed_size;
+    header->uncompressed_size = entry->uncompressed_size;
+    header->file_name_length = entry->file_name_length;
+    memcpy(header +1, entry +1, entry->file_name_length);
+    return sizeof(*header) + entry->file_name_length;
+}
+
+/* both tiles give the same directory entry, but for the offset */
+static int same_entry(delta_tile_t * a, delta_tile_t * b, local_file_header_t * header_a,
+                      local_file_header_t * header_b) {
+    uint64_t size = directory_header(a, header_a);
+    return (size == directory_header(b, header_b)) && (memcmp(header_a, header_b, size) == 0);
+}
+
+static int compare_tile_name(const void * a, const void * b) {
+    const delta_tile_t * ta = a;
+    const delta_tile_t * tb = b;
+    int order = memcmp(ta->name, tb->name, (ta->name_length < tb->name_length) ? ta->name_length : tb->name_length);
+    if(order != 0)
+        return order;
+    return (int)ta->name_length - (int)tb->name_length;
+}
+
+static int same_tile(delta_tile_t * a, delta_tile_t * b) {
+    return (a->crc32 == b->crc32) && (a->size == b->size) && (a->compression_method == b->compression_method);
+}
+
+/* the old header moved to offset is the new one, as apply_delta will write it */
+static int same_header(delta_binfile_t * old, delta_tile_t * old_tile, delta_binfile_t * new,
+                       delta_tile_t * new_tile, local_file_header_t * moved) {
+    local_file_header_t * header;
+    if(old_tile->header_size != new_tile->header_size)
+        return 0;
+    if((header = peek_header(old, old_tile)) == NULL)
+        return 0;
+    memcpy(moved, header, old_tile->header_size);
+    patch_file_length(new_tile->offset, moved, old_tile->size);
+    if((header = peek_header(new, new_tile)) == NULL)
+        return 0;
+    return memcmp(moved, header, new_tile->header_size) == 0;
+}
+
+static void flush_op(delta_writer_t * writer) {
+    delta_op_t * op = &(writer->op);
+    if((op->kind == DELTA_END) || writer->error)
+        return;
+    if(fwrite(op, sizeof(*op), 1, writer->outfile) != 1)
+        writer->error = 1;
+    writer->written += sizeof(*op);
+    if((op->kind == DELTA_NEW_TILES) || (op->kind == DELTA_LITERAL)) {
+        if((fseeko(writer->newfile, writer->new_offset, SEEK_SET) != 0)
+                || (copy_file_data(writer->new_size, writer->newfile, writer->outfile, NULL) != writer->new_size))
+            writer->error = 1;
+        writer->written += writer->new_size;
+    }
+    memset(op, 0, sizeof(*op));
+}
+
+/* one tile or some other bytes of the new binfile. old_offset is where the tile is in
+ * the old one for DELTA_OLD_TILES. */
+static void add_op(delta_writer_t * writer, uint32_t kind, uint64_t old_offset, uint64_t new_offset, uint64_t size) {
+    delta_op_t * op = &(writer->op);
+    if((kind == DELTA_LITERAL) && (size == 0))
+        return;
+    if(op->kind == kind) {
+        if(((kind == DELTA_OLD_TILES) || (kind == DELTA_OLD_SHARED)) && (writer->next_old == old_offset)) {
+            op->count ++;
+            writer->next_old += size;
+            return;
+        }
+        if(kind == DELTA_NEW_TILES) {
+            op->count ++;
+            writer->new_size += size;
+            return;
+        }
+    }
+    flush_op(writer);
+    op->kind = kind;
+    op->count = (kind == DELTA_LITERAL) ? size : 1;
+    op->offset = ((kind == DELTA_OLD_TILES) || (kind == DELTA_OLD_SHARED)) ? old_offset : 0;
+    writer->next_old = old_offset + size;
+    writer->new_offset = new_offset;
+    writer->new_size = size;
+}
+
+/* a placeholder the old binfile doesn't have, its header goes into the patch */
+static void add_shared(delta_writer_t * writer, delta_tile_t * tile, local_file_header_t * header) {
+    uint64_t size = directory_header(tile, header);
+    flush_op(writer);
+    writer->op.kind = DELTA_NEW_SHARED;
+    writer->op.count = 1;
+    if((fwrite(&(writer->op), sizeof(writer->op), 1, writer->outfile) != 1)
+            || (fwrite(header, size, 1, writer->outfile) != 1))
+        writer->error = 1;
+    writer->written += sizeof(writer->op) + size;
+    memset(&(writer->op), 0, sizeof(writer->op));
+}
+
+/* central directory and trailer at offset for the tiles in storage, in the order of the runs */
+static int write_directory(local_file_header_storage_t * tiles, delta_run_t * runs, uint64_t count,
+                           uint64_t offset, FILE * outfile, uint64_t * written) {
+    local_file_header_storage_t storage;
+    local_file_header_t ** headers;
+    header_arena_block_t * block;
+    uint64_t directory_size;
+    uint64_t i;
+    uint64_t j;
+    uint64_t n = 0;
+    int ret = -1;
+
+    memset(&storage, 0, sizeof(storage));
+    headers = malloc((tiles->count +1) * sizeof(local_file_header_t *));
+    if(headers == NULL)
+        return -1;
+    for(block = tiles->first; block != NULL; block = block->next) {
+        uint64_t used = 0;
+        while(used < block->used) {
+            local_file_header_t * header = (local_file_header_t *)(((char *)(block +1)) + used);
+            headers[n ++] = header;
+            used += sizeof(*header) + header->file_name_length + header->extra_field_length;
+        }
+    }
+    for(i = 0; i < count; i ++) {
+        if((runs[i].first > tiles->count) || (runs[i].count > tiles->count - runs[i].first))
+            goto done;
+        for(j = runs[i].first; j < runs[i].first + runs[i].count; j ++) {
+            local_file_header_t * header = headers[j];
+            uint64_t size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+            memcpy(storage_add_header(&storage, size), header, size);
+            remember_local_file(&storage, header, tiles->offsets[j]);
+        }
+    }
+    if(storage.count != tiles->count)
+        goto done;
+    directory_size = write_central_directory(&storage, outfile);
+    *written = directory_size
+               + write_end_of_central_directory(offset + directory_size, offset, directory_size, &storage, outfile);
+    ret = 0;
+done:
+    free(headers);
+    free_storage(&storage);
+    return ret;
+}
+
+static int compare_directory_order(const void * a, const void * b) {
+    const delta_tile_t * ta = *(const delta_tile_t **)a;
+    const delta_tile_t * tb = *(const delta_tile_t **)b;
+    /* names point into the directory */
+    if(ta->name < tb->name)
+        return -1;
+    return (ta->name > tb->name);
+}
+
+/* the runs of tiles in directory order, NULL if that directory isn't the one apply_delta
+ * would write at offset */
+static delta_run_t * directory_runs(delta_binfile_t * new, uint64_t offset, uint64_t * count) {
+    local_file_header_storage_t storage;
+    delta_tile_t ** order;
+    delta_run_t * runs = NULL;
+    uint64_t i;
+    char * directory = NULL;
+    size_t size = 0;
+    uint64_t written;
+    void * tail;
+    FILE * file;
+    int same = 0;
+
+    memset(&storage, 0, sizeof(storage));
+    *count = 0;
+    order = malloc((new->directory.count +1) * sizeof(delta_tile_t *));
+    runs = malloc((new->directory.count +1) * sizeof(delta_run_t));
+    if((order == NULL) || (runs == NULL))
+        goto done;
+    for(i = 0; i < new->directory.count; i ++) {
+        delta_tile_t * tile = &(new->tiles[i]);
+        local_file_header_t * header;
+        if(shared_tile(new, i)) {
+            /* the shared local header has another name */
+            header = storage_add_header(&storage, sizeof(*header) + tile->entry->file_name_length);
+            directory_header(tile, header);
+        } else {
+            if((header = peek_header(new, tile)) == NULL)
+                goto done;
+            memcpy(storage_add_header(&storage, tile->header_size), header, tile->header_size);
+        }
+        remember_local_file(&storage, header, tile->offset);
+        order[i] = tile;
+    }
+    qsort(order, new->directory.count, sizeof(delta_tile_t *), compare_directory_order);
+    for(i = 0; i < new->directory.count; i ++) {
+        uint64_t number = order[i] - new->tiles;
+        if((*count > 0) && (runs[*count -1].first + runs[*count -1].count == number)) {
+            runs[*count -1].count ++;
+        } else {
+            runs[*count].first = number;
+            runs[*count].count = 1;
+            (*count) ++;
+        }
+    }
+
+    file = open_memstream(&directory, &size);
+    if(file == NULL)
+        goto done;
+    if(write_directory(&storage, runs, *count, offset, file, &written) != 0) {
+        fclose(file);
+        goto done;
+    }
+    fclose(file);
+    if((size == new->size - offset) && (input_seek(&(new->input), offset) == 0)
+            && ((tail = input_peek(&(new->input), size)) != NULL))
+        same = (memcmp(directory, tail, size) == 0);
+done:
+    free(directory);
+    free(order);
+    free_storage(&storage);
+    if(!same) {
+        free(runs);
+        return NULL;
+    }
+    return runs;
+}
+
+int create_delta(FILE * oldfile, FILE * newfile, FILE * outfile) {
+    delta_binfile_t old;
+    delta_binfile_t new;
+    delta_tile_t * by_name = NULL;
+    delta_tile_t ** matches = NULL;
+    delta_run_t * runs = NULL;
+    uint64_t run_count;
+    local_file_header_t * moved = NULL;
+    local_file_header_t * rebuilt = NULL;
+    delta_writer_t writer;
+    delta_header_t header;
+    uint64_t position = 0;
+    uint64_t reused_bytes = 0;
+    uint64_t new_bytes = 0;
+    uint64_t i;
+    int ret = 1;
+
+    if(open_binfile(&old, oldfile, "old") != 0)
+        return 1;
+    if(open_binfile(&new, newfile, "new") != 0) {
+        close_binfile(&old);
+        return 1;
+    }
+    /* room for the largest possible local file header */
+    moved = malloc(sizeof(local_file_header_t) + 2 * 0xFFFF);
+    rebuilt = malloc(sizeof(local_file_header_t) + 2 * 0xFFFF);
+    by_name = malloc((old.directory.count +1) * sizeof(delta_tile_t));
+    matches = calloc(new.directory.count +1, sizeof(delta_tile_t *));
+    if((moved == NULL) || (rebuilt == NULL) || (by_name == NULL) || (matches == NULL)) {
+        fprintf(stderr, "ERROR out of memory\n");
+        goto done;
+    }
+    memcpy(by_name, old.tiles, old.directory.count * sizeof(delta_tile_t));
+    qsort(by_name, old.directory.count, sizeof(delta_tile_t), compare_tile_name);
+
+    /* unchanged tiles first, the header counts them */
+    memset(&header, 0, sizeof(header));
+    for(i = 0; i < new.directory.count; i ++) {
+        delta_tile_t * tile = &(new.tiles[i]);
+        delta_tile_t * match = bsearch(tile, by_name, old.directory.count, sizeof(delta_tile_t), compare_tile_name);
+        if(shared_tile(&new, i)) {
+            /* only the directory entry is left of it */
+            if((match != NULL) && same_entry(match, tile, moved, rebuilt)) {
+                matches[i] = match;
+                header.reused ++;
+            }
+        } else if((match != NULL) && same_tile(match, tile) && same_header(&old, match, &new, tile, moved)) {
+            matches[i] = match;
+            header.reused ++;
+            reused_bytes += tile->size;
+        } else
+            new_bytes += tile->size;
+    }
+    memcpy(header.magic, DELTA_MAGIC, sizeof(header.magic));
+    header.version = DELTA_VERSION;
+    header.old_directory_crc = old.directory_crc;
+    header.old_size = old.size;
+    header.new_size = new.size;
+    header.new_count = new.directory.count;
+    memset(&writer, 0, sizeof(writer));
+    writer.outfile = outfile;
+    writer.newfile = newfile;
+    if(fwrite(&header, sizeof(header), 1, outfile) != 1)
+        writer.error = 1;
+    writer.written = sizeof(header);
+
+    for(i = 0; (i < new.directory.count) && !writer.error; i ++) {
+        delta_tile_t * tile = &(new.tiles[i]);
+        delta_tile_t * match = matches[i];
+        /* placeholders of compact binfiles share a local header, the directory lists them */
+        if(shared_tile(&new, i)) {
+            if(match != NULL)
+                add_op(&writer, DELTA_OLD_SHARED, match->number, 0, 1);
+            else
+                add_shared(&writer, tile, moved);
+            continue;
+        }
+        if(tile->offset < position) {
+            fprintf(stderr, "ERROR tiles overlap at %ld in the new binfile\n", tile->offset);
+            goto done;
+        }
+        /* whatever is between the tiles goes into the patch as it is */
+        add_op(&writer, DELTA_LITERAL, 0, position, tile->offset - position);
+        if(match != NULL)
+            add_op(&writer, DELTA_OLD_TILES, match->offset, tile->offset, match->header_size + match->size);
+        else
+            add_op(&writer, DELTA_NEW_TILES, 0, tile->offset, tile->header_size + tile->size);
+        position = tile->offset + tile->header_size + tile->size;
+    }
+    runs = directory_runs(&new, position, &run_count);
+    if(runs != NULL) {
+        flush_op(&writer);
+        writer.op.kind = DELTA_DIRECTORY;
+        writer.op.count = run_count;
+        if((fwrite(&(writer.op), sizeof(writer.op), 1, outfile) != 1)
+                || (fwrite(runs, sizeof(delta_run_t), run_count, outfile) != run_count))
+            writer.error = 1;
+        writer.written += sizeof(writer.op) + run_count * sizeof(delta_run_t);
+        memset(&(writer.op), 0, sizeof(writer.op));
+    } else {
+        /* not written by the extractor, ship it */
+        add_op(&writer, DELTA_LITERAL, 0, position, new.size - position);
+    }
+    flush_op(&writer);
+    if((fwrite(&(writer.op), sizeof(writer.op), 1, outfile) != 1) || writer.error || (fflush(outfile) != 0)) {
+        fprintf(stderr, "ERROR writing patch: %s\n", strerror(errno));
+        goto done;
+    }
+    fprintf(stderr, "patch of %ld bytes, %ld of %ld tiles (%ld bytes) unchanged, %ld bytes of new tiles\n",
+            writer.written + sizeof(writer.op), header.reused, header.new_count, reused_bytes, new_bytes);
+    ret = 0;
+done:
+    free(moved);
+    free(rebuilt);
+    free(runs);
+    free(matches);
+    free(by_name);
+    close_binfile(&new);
+    close_binfile(&old);
+    return ret;
+}
+
+/* count tiles of the old binfile from offset on, moved to where they land in the new one */
+static int copy_old_tiles(delta_binfile_t * old, uint64_t offset, uint64_t count, FILE * outfile,
+                          local_file_header_storage_t * storage, uint64_t * written, copy_statistics_t * stats) {
+    uint64_t i;
+    for(i = 0; i < count; i ++) {
+        local_file_header_t * header;
+        local_file_header_t * moved;
+        uint64_t header_size;
+        uint64_t size;
+        void * data;
+
+        if((input_seek(&(old->input), offset) != 0)
+                || ((header = input_peek(&(old->input), sizeof(*header))) == NULL)
+                || (header->local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)) {
+            fprintf(stderr, "ERROR patch expects a tile at %ld of the old binfile\n", offset);
+            return -1;
+        }
+        header_size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+        if((header = input_peek(&(old->input), header_size)) == NULL)
+            return -1;
+        size = get_file_length(header);
+        moved = storage_add_header(storage, header_size);
+        memcpy(moved, header, header_size);
+        patch_file_length(*written, moved, size);
+        remember_local_file(storage, moved, *written);
+        if(fwrite(moved, header_size, 1, outfile) != 1)
+            return -1;
+        offset += header_size;
+        if(size < DELTA_KERNEL_COPY) {
+            if((input_seek(&(old->input), offset) != 0) || ((data = input_peek(&(old->input), size)) == NULL)
+                    || (fwrite(data, 1, size, outfile) != size))
+                return -1;
+            stats->bytes[COPY_METHOD_BUFFERED] += size;
+        } else if((fseeko(old->input.file, offset, SEEK_SET) != 0)
+                  || (copy_file_data(size, old->input.file, outfile, stats) != size)) {
+            return -1;
+        }
+        offset += size;
+        *written += header_size + size;
+    }
+    return 0;
+}
+
+/* count tiles from the patch, headers already in place, none of them beyond end of the new binfile */
+static int copy_new_tiles(FILE * patchfile, uint64_t count, uint64_t end, FILE * outfile,
+                          local_file_header_storage_t * storage, uint64_t * written, copy_statistics_t * stats) {
+    uint64_t i;
+    for(i = 0; i < count; i ++) {
+        local_file_header_t header;
+        local_file_header_t * stored;
+        uint64_t header_size;
+        uint64_t size;
+
+        if((fread(&header, sizeof(header), 1, patchfile) != 1)
+                || (header.local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)) {
+            fprintf(stderr, "ERROR patch damaged, expected a tile\n");
+            return -1;
+        }
+        header_size = sizeof(header) + header.file_name_length + header.extra_field_length;
+        stored = storage_add_header(storage, header_size);
+        memcpy(stored, &header, sizeof(header));
+        if(fread(stored +1, header_size - sizeof(header), 1, patchfile) != 1) {
+            fprintf(stderr, "ERROR patch damaged, expected a tile\n");
+            return -1;
+        }
+        size = get_file_length(stored);
+        if((header_size > end - *written) || (size > end - *written - header_size)) {
+            fprintf(stderr, "ERROR patch damaged, tile of %ld bytes beyond the end of the new binfile\n", size);
+            return -1;
+        }
+        remember_local_file(storage, stored, *written);
+        if((fwrite(stored, header_size, 1, outfile) != 1)
+                || (copy_file_data(size, patchfile, outfile, stats) != size))
+            return -1;
+        *written += header_size + size;
+    }
+    return 0;
+}
+
+/* count placeholders sharing the local header written last, described by the old directory from first on */
+static int share_old_entries(delta_binfile_t * old, uint64_t first, uint64_t count,
+                             local_file_header_storage_t * storage) {
+    uint64_t i;
+    if((storage->count == 0) || (first > old->directory.count) || (count > old->directory.count - first)) {
+        fprintf(stderr, "ERROR patch damaged, no shared tiles %ld to %ld in the old binfile\n", first,
+                first + count);
+        return -1;
+    }
+    for(i = first; i < first + count; i ++) {
+        delta_tile_t * tile = &(old->tiles[i]);
+        local_file_header_t * header = storage_add_header(storage, sizeof(*header) + tile->entry->file_name_length);
+        directory_header(tile, header);
+        remember_local_file(storage, header, storage->offsets[storage->count -1]);
+    }
+    return 0;
+}
+
+/* count placeholders sharing the local header written last, headers from the patch */
+static int share_new_entries(FILE * patchfile, uint64_t count, local_file_header_storage_t * storage) {
+    uint64_t i;
+    for(i = 0; i < count; i ++) {
+        local_file_header_t header;
+        local_file_header_t * stored;
+        uint64_t header_size;
+
+        if((storage->count == 0) || (fread(&header, sizeof(header), 1, patchfile) != 1)
+                || (header.local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)
+                || (header.extra_field_length != 0)) {
+            fprintf(stderr, "ERROR patch damaged, expected a shared tile\n");
+            return -1;
+        }
+        header_size = sizeof(header) + header.file_name_length + header.extra_field_length;
+        stored = storage_add_header(storage, header_size);
+        memcpy(stored, &header, sizeof(header));
+        if(fread(stored +1, header_size - sizeof(header), 1, patchfile) != 1) {
+            fprintf(stderr, "ERROR patch damaged, expected a shared tile\n");
+            return -1;
+        }
+        remember_local_file(storage, stored, storage->offsets[storage->count -1]);
+    }
+    return 0;
+}
+
+int apply_delta(FILE * oldfile, FILE * patchfile, FILE * outfile) {
+    delta_binfile_t old;
+    local_file_header_storage_t storage;
+    delta_header_t header;
+    delta_op_t op;
+    copy_statistics_t stats;
+    uint64_t written = 0;
+    uint64_t reused = 0;
+    int ret = 1;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&storage, 0, sizeof(storage));
+    if(open_binfile(&old, oldfile, "old") != 0)
+        return 1;
+    if(fread(&header, sizeof(header), 1, patchfile) != 1) {
+        fprintf(stderr, "ERROR reading patch: %s\n", feof(patchfile) ? "too short" : strerror(errno));
+        goto done;
+    }
+    if((memcmp(header.magic, DELTA_MAGIC, sizeof(header.magic)) != 0) || (header.version != DELTA_VERSION)) {
+        fprintf(stderr, "ERROR not a patch or unsupported version\n");
+        goto done;
+    }
+    if((header.old_size != old.size) || (header.old_directory_crc != old.directory_crc)) {
+        fprintf(stderr, "ERROR patch was made for a different old binfile\n");
+        goto done;
+    }
+    /* every tile has a directory entry in the new binfile */
+    if(header.new_count > header.new_size / sizeof(central_directory_header_t)) {
+        fprintf(stderr, "ERROR patch damaged, %ld tiles in %ld bytes\n", header.new_count, header.new_size);
+        goto done;
+    }
+    for(;;) {
+        int error = 0;
+        if(fread(&op, sizeof(op), 1, patchfile) != 1) {
+            fprintf(stderr, "ERROR reading patch: %s\n", feof(patchfile) ? "truncated" : strerror(errno));
+            goto done;
+        }
+        if(op.kind == DELTA_END)
+            break;
+        /* no op may go beyond the tiles or bytes of the new binfile, checked before it allocates or writes */
+        if((op.kind == DELTA_LITERAL) ? (op.count > header.new_size - written)
+                : ((op.kind != DELTA_DIRECTORY) && (op.count > header.new_count - storage.count))) {
+            fprintf(stderr, "ERROR patch damaged, op %d for %ld more %s than the new binfile has\n", op.kind,
+                    op.count, (op.kind == DELTA_LITERAL) ? "bytes" : "tiles");
+            goto done;
+        }
+        switch(op.kind) {
+        case DELTA_OLD_TILES:
+            reused += op.count;
+            error = copy_old_tiles(&old, op.offset, op.count, outfile, &storage, &written, &stats);
+            break;
+        case DELTA_NEW_TILES:
+            error = copy_new_tiles(patchfile, op.count, header.new_size, outfile, &storage, &written, &stats);
+            break;
+        case DELTA_OLD_SHARED:
+            reused += op.count;
+            error = share_old_entries(&old, op.offset, op.count, &storage);
+            break;
+        case DELTA_NEW_SHARED:
+            error = share_new_entries(patchfile, op.count, &storage);
+            break;
+        case DELTA_LITERAL:
+            error = (copy_file_data(op.count, patchfile, outfile, &stats) != op.count);
+            written += op.count;
+            break;
+        case DELTA_DIRECTORY: {
+            uint64_t size = 0;
+            delta_run_t * runs = NULL;
+            /* there can't be more runs than tiles */
+            if(op.count <= storage.count)
+                runs = malloc((op.count +1) * sizeof(delta_run_t));
+            error = (runs == NULL) || (fread(runs, sizeof(delta_run_t), op.count, patchfile) != op.count)
+                    || (write_directory(&storage, runs, op.count, written, outfile, &size) != 0);
+            free(runs);
+            written += size;
+            break;
+        }
+        default:
+            fprintf(stderr, "ERROR patch damaged, unknown op %d\n", op.kind);
+            goto done;
+        }
+        if(error || (written > header.new_size)) {
+            fprintf(stderr, "ERROR applying patch after %ld bytes\n", written);
+            goto done;
+        }
+    }
+    if(written != header.new_size) {
+        fprintf(stderr, "ERROR patch ends after %ld of %ld bytes\n", written, header.new_size);
+        goto done;
+    }
+    if(fflush(outfile) != 0) {
+        fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+        goto done;
+    }
+    fprintf(stderr, "wrote %ld tiles, %ld of them from the old binfile\n", storage.count, reused);
+    print_copy_statistics(&stats);
+    ret = 0;
+done:
+    free_storage(&storage);
+    close_binfile(&old);
+    return ret;
+}
@@ -0,0 +1,80 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __delta_h
+#define __delta_h
+#include <stdio.h>
+#include <stdint.h>
+
+/* Patch from one binfile to another, little endian like the zip structures:
+ *   delta_header_t
+ *   delta_op_t, each followed by the bytes it brings along
+ *   ...
+ *   delta_op_t DELTA_END
+ * Replaying the ops in order writes the new binfile byte for byte. Tiles with
+ * the same name, crc, size and compression in both are taken from the old one
+ * and only moved, the central directory is written from the local file
+ * headers like the extractor does. Placeholders of compact binfiles have no
+ * local file header of their own, theirs is rebuilt from the directory. */
+#define DELTA_MAGIC "NAVITDLT"
+#define DELTA_VERSION 1
+
+enum delta_op_kind {
+    DELTA_END,
+    DELTA_OLD_TILES,  /* count tiles of the old binfile, starting with the local file header at offset */
+    DELTA_NEW_TILES,  /* count tiles follow, header and data as in the new binfile */
+    DELTA_LITERAL,    /* count bytes follow */
+    DELTA_DIRECTORY,  /* central directory and trailer for the tiles written so far, listed in
+                       * the order of the count delta_run_t that follow */
+    DELTA_OLD_SHARED, /* count empty tiles sharing the local file header written last, as the
+                       * central directory entries of the old binfile from number offset on */
+    DELTA_NEW_SHARED  /* count empty tiles sharing the local file header written last, their
+                       * local file headers without extra field follow */
+};
+
+typedef struct delta_header delta_header_t;
+struct delta_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t old_directory_crc; /* of central directory and trailer, identifies the old binfile */
+    uint64_t old_size;
+    uint64_t new_size;
+    uint64_t new_count;  /* tiles in the new binfile */
+    uint64_t reused;     /* of them taken from the old one */
+};
+
+typedef struct delta_op delta_op_t;
+struct delta_op {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t count;
+};
+
+/* tiles first to first + count -1, numbered in the order they were written */
+typedef struct delta_run delta_run_t;
+struct delta_run {
+    uint64_t first;
+    uint64_t count;
+};
+
+int create_delta(FILE * oldfile, FILE * newfile, FILE * outfile);
+int apply_delta(FILE * oldfile, FILE * patchfile, FILE * outfile);
+#endif
@@ -24,302 +24,1012 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <getopt.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "zipfile.h"
+#include "input.h"
+#include "tileindex.h"
+#include "copypool.h"
+#include "clip.h"
+#include "verify.h"
+#include "checkpoint.h"
+#include "regions.h"
+#include "tilecover.h"
+#include "pipeline.h"
+#include "stats.h"
 #include "map.h"
+#include "extractor.h"
 
-typedef struct extractor_parameters extractor_parameters_t;
-struct extractor_parameters {
-    struct rect area;
-    double lat_bottom_left;
-    double lon_bottom_left;
-    double lat_top_right;
-    double lon_top_right;
+/* unknown data in a stream is searched for the next header this much at a time */
+#define RESYNC_WINDOW (64*1024)
+
+static int filter_tile(struct rect *bbox, int depth, extract_sink_t *sink) {
+    if(((itembin_bbox_intersects(&(sink->area), bbox))
+            && ((sink->polygon == NULL) || polygon_area_intersects(sink->polygon, bbox)))
+            || (depth == 0)
+            || (sink->overview && itembin_bbox_intersects(&(sink->outer), bbox))) {
+        return 0;
+    } else
+        return 1;
+}
+
+static int rect_covers(struct rect *area, struct rect *bbox) {
+    return (bbox->l.x >= area->l.x) && (bbox->l.y >= area->l.y) && (bbox->h.x <= area->h.x) && (bbox->h.y <= area->h.y);
+}
+
+static int tile_inside(struct rect *bbox, extract_sink_t *sink) {
+    if(sink->overview && rect_covers(&(sink->outer), bbox))
+        return 1;
+    if(!rect_covers(&(sink->area), bbox))
+        return 0;
+    return (sink->polygon == NULL) || polygon_area_covers(sink->polygon, bbox);
+}
+
+/* the boxes of all sinks, for a first look at a tile in one go */
+typedef struct sink_filter sink_filter_t;
+struct sink_filter {
+    region_set_t areas;
+    region_set_t outers;   /* empty for sinks without outer area */
+    uint64_t * hits;
+    uint64_t * outer_hits;
+    int outer_depth;       /* deepest of the sinks */
+    tile_walk_t walk;      /* bboxes of the local headers */
 };
 
-static void usage (void) {
-    fprintf(stderr,"\n"
-            " usage: navit_binfile_extractor [coordinates] \n"
-            "\n"
-            " NavIT binfile extractor extracts given area from a NavIT binfile\n"
-            " It reads binfile from stdin and writes result to stdout. \n"
-            "\n"
-            " Coordinates\n"
-            "  <bottom left lon> <bottom left lat> <top right lon> <top right lat>\n"
-            "\n"
-            " Example: extract Munich, Bavaria from world map\n"
-            "  cat world.bin | navit_binfile_extractor 11.3 47.9 11.7 48.2 > munich.bin\n"
-            "\n");
-}
-
-static int filter_file(local_file_header_t * header, struct rect *r) {
+static int sink_filter_init(sink_filter_t *filter, extract_sink_t *sinks, int count) {
+    int i;
+    memset(filter, 0, sizeof(*filter));
+    if((region_set_init(&(filter->areas), count) != 0) || (region_set_init(&(filter->outers), count) != 0))
+        return -1;
+    filter->hits = calloc(REGION_WORDS(count), sizeof(uint64_t));
+    filter->outer_hits = calloc(REGION_WORDS(count), sizeof(uint64_t));
+    if((filter->hits == NULL) || (filter->outer_hits == NULL))
+        return -1;
+    for(i = 0; i < count; i ++) {
+        region_set_put(&(filter->areas), i, &(sinks[i].area));
+        if(sinks[i].outer_depth > 0)
+            region_set_put(&(filter->outers), i, &(sinks[i].outer));
+        if(sinks[i].outer_depth > filter->outer_depth)
+            filter->outer_depth = sinks[i].outer_depth;
+    }
+    tile_walk_init(&(filter->walk), 1);
+    return 0;
+}
+
+static void sink_filter_free(sink_filter_t *filter) {
+    region_set_free(&(filter->areas));
+    region_set_free(&(filter->outers));
+    free(filter->hits);
+    free(filter->outer_hits);
+}
+
+/* a tile is rejected if every sink rejects it. filter may be NULL, then every
+ * sink looks at the tile on its own. */
+static int filter_sinks(sink_filter_t *filter, struct rect *bbox, int depth, extract_sink_t *sinks, int count) {
+    int i;
+    int rejected = 1;
+    if(filter != NULL) {
+        region_set_test(&(filter->areas), bbox, filter->hits);
+        if(depth <= filter->outer_depth)
+            region_set_test(&(filter->outers), bbox, filter->outer_hits);
+    }
+    for(i = 0; i < count; i ++) {
+        sinks[i].overview = (sinks[i].outer_depth > 0) && (depth <= sinks[i].outer_depth);
+        /* nothing of the sink near the tile */
+        if((filter != NULL) && (depth > 0) && !REGION_HIT(filter->hits, i)
+                && !(sinks[i].overview && REGION_HIT(filter->outer_hits, i))) {
+            sinks[i].keep = 0;
+            sinks[i].clip = 0;
+            continue;
+        }
+        sinks[i].keep = !filter_tile(bbox, depth, &(sinks[i]));
+        sinks[i].clip = sinks[i].keep && (sinks[i].margin >= 0) && (depth > 0) && !tile_inside(bbox, &(sinks[i]));
+        if(sinks[i].keep)
+            rejected = 0;
+    }
+    return rejected;
+}
+
+/* zero terminated name of the tile */
+static void header_name(local_file_header_t * header, char * name, uint16_t size) {
+    uint16_t length = header->file_name_length;
+    if(length >= size)
+        length = size -1;
+    memcpy(name, header +1, length);
+    name[length]=0;
+}
+
+int filter_file(local_file_header_t * header, extract_sink_t *sinks, int count) {
     char name[1024];
     struct rect bbox;
-    /* zero terminate the name */
-    memcpy(name, header +1, header->file_name_length);
-    name[header->file_name_length]=0;
 
+    header_name(header, name, sizeof(name));
     tile_bbox(name, &bbox, 1);
-    //fprintf(stderr,"%s -> (%d,%d)-(%d,%d)\n", name, bbox.l.x, bbox.l.y, bbox.h.x, bbox.h.y);
-    if((itembin_bbox_intersects(r, &bbox)) || (tile_len(name) == 0)) {
-        fprintf(stderr, "keep %s\n", name);
-        return 0;
-    } else
-        return 1;
+    return filter_sinks(NULL, &bbox, tile_len(name), sinks, count);
 }
 
-static int64_t process_local_file(uint64_t offset, local_file_header_t  *header, FILE *infile, FILE *outfile,
-                                  struct rect *r,
-                                  local_file_header_t **stored_header) {
-    *stored_header = NULL;
-    int keep_zerofile =1;
-    /* read rest of header */
-    if(fread(((uint32_t *)(header)) +1, sizeof(*header) - sizeof(header->local_file_header_signature), 1, infile) > 0) {
-        char * filename = NULL;
-        uint64_t filesize;
-        //fprintf(stderr, "filename length %d, extra length %d\n", header->file_name_length, header->extra_field_length);
-        *stored_header = (local_file_header_t*) malloc(sizeof(*header) + header->file_name_length + header->extra_field_length);
-        /* copy the header */
-        memcpy(*stored_header, header, sizeof(*header));
-        /* read filename and extra fields*/
-        filename = (char *)((*stored_header) +1);
-        fread(filename, header->file_name_length + header->extra_field_length, 1, infile);
-
-        /* get number of bytes to copy */
-        filesize=get_file_length(*stored_header);
-
-        /* filter file */
-        if(filter_file(*stored_header, r)) {
-            /* dump the data */
-            copy_file_data(filesize, infile, NULL);
-            if(keep_zerofile) {
-                filesize = 0;
-            } else {
-                free(*stored_header);
-                *stored_header = NULL;
-                return 0;
-            }
+/* patch the header stored for this sink, write it and remember it for the central directory */
+static void write_local_file(extract_sink_t *sink, local_file_header_t *header, uint64_t filesize) {
+    uint64_t header_size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+    /* NavIT finds tiles by their number in the central directory, so every placeholder
+     * needs its entry there. The local header of an empty tile has nothing to say. */
+    if(sink->compact && (filesize == 0)) {
+        if(sink->placeholder >= 0) {
+            patch_file_length (sink->placeholder, header, 0);
+            remember_local_file (&(sink->storage), header, sink->placeholder);
+            return;
+        }
+        sink->placeholder = sink->written;
+    }
+    /* patch the new location and file size after filter */
+    patch_file_length (sink->written, header, filesize);
+    /* write out the new header */
+    fwrite(header, header_size, 1, sink->outfile);
+    remember_local_file (&(sink->storage), header, sink->written);
+    sink->written += header_size + filesize;
+}
+
+static void count_tile(extract_sink_t *sink, int depth, int kept) {
+    if(depth >= STATS_DEPTHS)
+        depth = STATS_DEPTHS -1;
+    if(kept)
+        sink->kept[depth] ++;
+    else
+        sink->placeholders[depth] ++;
+}
+
+/* hand the tile data to the clip workers for every sink clipping or recompressing it */
+static int submit_clip_jobs(binfile_input_t *input, extract_sink_t *sinks, int count, uint16_t compression_method,
+                            uint64_t filesize, local_file_header_t **headers, clip_pool_t *clips) {
+    clip_data_t * shared;
+    char * data;
+    int i;
+
+    data = input_peek(input, filesize);
+    if(data == NULL)
+        return -1;
+    /* a view of the map stays valid, the stdio buffer doesn't */
+    shared = clip_data_new(data, filesize, input->map == NULL);
+    for(i = 0; i < count; i ++) {
+        clip_job_t * job;
+        if(headers[i] == NULL)
+            continue;
+        job = calloc(1, sizeof(*job));
+        job->input = shared;
+        job->compression_method = compression_method;
+        if(sinks[i].overview) {
+            /* shallow tiles keep what reaches into either area */
+            struct rect *inner = &(sinks[i].area);
+            job->area = sinks[i].outer;
+            job->area.l.x = (inner->l.x < job->area.l.x) ? inner->l.x : job->area.l.x;
+            job->area.l.y = (inner->l.y < job->area.l.y) ? inner->l.y : job->area.l.y;
+            job->area.h.x = (inner->h.x > job->area.h.x) ? inner->h.x : job->area.h.x;
+            job->area.h.y = (inner->h.y > job->area.h.y) ? inner->h.y : job->area.h.y;
+            job->polygon = NULL;
+        } else {
+            job->area = sinks[i].area;
+            job->polygon = sinks[i].polygon;
+        }
+        job->margin = sinks[i].clip ? sinks[i].margin : -1;
+        job->recompress = sinks[i].recompress;
+        job->owner = &(sinks[i]);
+        job->header = headers[i];
+        job->slot = sinks[i].storage.count -1;
+        clip_pool_submit(clips, job);
+    }
+    clip_data_release(shared);
+    return 0;
+}
+
+/* append the clipped tiles behind the others, in archive order: the oldest results
+ * until no more than backlog input bytes wait in the pool */
+static void write_clipped(clip_pool_t *clips, uint64_t backlog, run_statistics_t *stats) {
+    clip_job_t * job;
+
+    /* only this thread adds and takes jobs */
+    while((clips->backlog > backlog) && ((job = clip_pool_take(clips)) != NULL)) {
+        extract_sink_t * sink = job->owner;
+        local_file_header_t * header = job->header;
+        uint64_t header_size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+        char * data = job->data;
+        uint64_t size = job->size;
+
+        if(job->clipped) {
+            zip64_extended_information_t * zip64_extended = get_zip64_extension(header);
+            header->crc32 = job->crc32;
+            if(zip64_extended != NULL)
+                zip64_extended->uncompressed_size = job->uncompressed_size;
+            else
+                header->uncompressed_size = job->uncompressed_size;
+            stats->rewritten_before += get_file_length(header);
+            stats->rewritten_after += size;
+            stats->rewritten ++;
+        } else {
+            data = job->input->data;
+            size = job->input->size;
         }
+        stats->items += job->items;
+        stats->items_dropped += job->dropped;
+        patch_file_length(sink->written, header, size);
+        fwrite(header, header_size, 1, sink->outfile);
+        if(size > 0)
+            fwrite(data, size, 1, sink->outfile);
+        stats->copy.bytes[COPY_METHOD_BUFFERED] += size;
+        update_local_file(&(sink->storage), job->slot, header, sink->written);
+        sink->written += header_size + size;
+        clip_job_free(job);
+    }
+}
 
-        /* patch the new location and file size after filter */
-        patch_file_length (offset, *stored_header, filesize);
+static int64_t process_local_file(binfile_input_t *input, extract_sink_t *sinks, int count,
+                                  sink_filter_t *filter, tile_index_t *index, tile_index_entry_t *entry,
+                                  copy_plan_t *plan, clip_pool_t *clips, verify_lane_t *verify,
+                                  run_statistics_t *stats) {
+    local_file_header_t * header;
+    local_file_header_t fixed;
+    uint64_t header_size;
+    uint64_t filesize;
+    FILE * outfiles[count];
+    local_file_header_t * clip_headers[count];
+    char name[1024];
+    struct rect bbox;
+    int depth;
+    int kept = 0;
+    int clipped = 0;
+    int planned = 0;
+    int placeholders = 0;
+    int i;
+    int keep_zerofile =1;
 
-        /* write out the new header */
-        fwrite(*stored_header, sizeof(*header) + header->file_name_length + header->extra_field_length, 1, outfile);
+    stats_phase(stats, PHASE_HEADER);
+    /* parse the header in place */
+    header = input_peek(input, sizeof(*header));
+    if(header == NULL)
+        return -1;
+    header_size = sizeof(*header) + header->file_name_length + header->extra_field_length;
+    header = input_peek(input, header_size);
+    if(header == NULL)
+        return -1;
+    //fprintf(stderr, "filename length %d, extra length %d\n", header->file_name_length, header->extra_field_length);
 
-        /* copy the compressed file */
-        copy_file_data(filesize, infile, outfile);
+    /* get number of bytes to copy */
+    filesize=get_file_length(header);
 
-        //fprintf(stderr,"Filename %.*s, %ld\n", header->file_name_length, filename, filesize);
-        /* done */
-        return sizeof(*header) + header->file_name_length + header->extra_field_length + filesize;
+    /* filter file */
+    stats_phase(stats, PHASE_FILTER);
+    header_name(header, name, sizeof(name));
+    tile_walk_bbox(&(filter->walk), name, &bbox);
+    depth = tile_len(name);
+    filter_sinks(filter, &bbox, depth, sinks, count);
+    stats_phase(stats, PHASE_HEADER);
+    for(i = 0; i < count; i ++) {
+        local_file_header_t * stored_header;
+        clip_headers[i] = NULL;
+        count_tile(&(sinks[i]), depth, sinks[i].keep);
+        if(!sinks[i].keep) {
+            if(!keep_zerofile)
+                continue;
+            placeholders ++;
+            if(entry != NULL)
+                /* same placeholder as if nobody had kept the tile */
+                stored_header = tile_index_placeholder(index, entry, &(sinks[i].storage));
+            else
+                stored_header = placeholder_header(&(sinks[i].storage), (char *)(header +1), header->file_name_length,
+                                                   header->general_purpose_bit_flag, header->last_mod_file_time,
+                                                   header->last_mod_file_date);
+            write_local_file(&(sinks[i]), stored_header, 0);
+            continue;
+        }
+        /* keep a copy to patch and to build the central directory from */
+        stored_header = storage_add_header(&(sinks[i].storage), header_size);
+        memcpy(stored_header, header, header_size);
+        if((sinks[i].clip || (sinks[i].keep && sinks[i].recompress && clip_deflated(header)))
+                && (clips != NULL) && (filesize > 0) && clip_supported(header)) {
+            /* take the place in the directory, the data follows once clipped */
+            remember_local_file(&(sinks[i].storage), stored_header, 0);
+            clip_headers[i] = stored_header;
+            clipped ++;
+            continue;
+        }
+        sinks[i].clip = 0;
+        write_local_file(&(sinks[i]), stored_header, sinks[i].keep ? filesize : 0);
+        if(sinks[i].keep && sinks[i].plan)
+            planned ++;
+        else if(sinks[i].keep)
+            outfiles[kept ++] = sinks[i].outfile;
+    }
+    input_skip(input, header_size);
+    stats_tile(stats, name, depth, kept + clipped + planned, placeholders);
+    stats->bytes_read += header_size;
+    if(kept + clipped > 0)
+        stats->bytes_read += filesize;
+
+    /* copy the compressed file, read once for all sinks keeping it */
+    stats_phase(stats, PHASE_COPY);
+    /* the data may take the place of the header in the peek buffer */
+    fixed = *header;
+    if((verify != NULL) && (kept + clipped > 0) && (filesize > 0)) {
+        char * data = input_peek(input, filesize);
+        clip_data_t * shared;
+        if(data == NULL)
+            return -1;
+        /* a view of the map stays valid, the stdio buffer doesn't */
+        shared = clip_data_new(data, filesize, input->map == NULL);
+        verify_lane_submit(verify, shared, &fixed, name);
+        clip_data_release(shared);
+    }
+    if((kept > 0) && (plan == NULL) && (clipped == 0)) {
+        if(input_copy_fanout(input, filesize, outfiles, kept, &(stats->copy)) != filesize)
+            return -1;
+    } else if(clipped > 0) {
+        if(submit_clip_jobs(input, sinks, count, fixed.compressionmethod, filesize, clip_headers, clips) != 0)
+            return -1;
+        /* the data is in memory now, the others get it from there */
+        for(i = 0; i < kept; i ++) {
+            if(plan != NULL) {
+                copy_plan_add(plan, fileno(input->file), input->position, fileno(outfiles[i]), ftello(outfiles[i]), filesize);
+                fseeko(outfiles[i], filesize, SEEK_CUR);
+            } else {
+                fwrite(input_peek(input, filesize), filesize, 1, outfiles[i]);
+                stats->copy.bytes[COPY_METHOD_BUFFERED] += filesize;
+            }
+        }
+        input_skip(input, filesize);
+        /* the results so far, written at a point that doesn't depend on the workers */
+        write_clipped(clips, CLIP_BACKLOG, stats);
+    } else {
+        /* leave a hole for the workers */
+        for(i = 0; i < kept; i ++) {
+            copy_plan_add(plan, fileno(input->file), input->position, fileno(outfiles[i]), ftello(outfiles[i]), filesize);
+            fseeko(outfiles[i], filesize, SEEK_CUR);
+        }
+        if(input_skip(input, filesize) != 0)
+            return -1;
     }
+
+    /* done */
+    return header_size + filesize;
 }
 
-static int64_t process_central_directory_header(uint64_t offset, central_directory_header_t  *header, FILE *infile,
-        FILE *outfile,
-        struct rect *r,
+static int64_t process_central_directory_header(binfile_input_t *input,
         central_directory_header_t **stored_header) {
+    central_directory_header_t * header;
 
     *stored_header = NULL;
-    /* read rest of header */
-    if(fread(((uint32_t *)(header)) +1, sizeof(*header) - sizeof(header->central_file_header_signature), 1, infile) > 0) {
-        char * filename = NULL;
+    /* skip over the header, the directory is rebuilt from the local files */
+    header = input_peek(input, sizeof(*header));
+    if(header != NULL) {
         //fprintf(stderr, "filename length %d, extra length %d, comment length %d\n", header->file_name_length,
         //        header->extra_field_length, header->file_comment_length);
-        *stored_header = (central_directory_header_t*) malloc(sizeof(*header) + header->file_name_length +
-                         header->extra_field_length +
-                         header->file_comment_length);
-        /* copy the header */
-        memcpy(*stored_header, header, sizeof(*header));
-        /* read filename and extra fieldsi and file comment*/
-        filename = (char *)((*stored_header) +1);
-        fread(filename, header->file_name_length + header->extra_field_length + header->file_comment_length, 1, infile);
-
-        //fprintf(stderr,"Filename %.*s\n", header->file_name_length, filename);
+        *stored_header = header;
+        input_skip(input, sizeof(*header) + header->file_name_length + header->extra_field_length +
+                   header->file_comment_length);
     }
-    return 0; /* as we wrote nothing */
+    return (header != NULL) ? 0 : -1; /* as we wrote nothing */
 }
 
-static int64_t process_end_of_central_dir_64(uint64_t offset, end_of_central_dir_64_t  *header, FILE *infile,
-        FILE *outfile,
-        struct rect *r,
+static int64_t process_end_of_central_dir_64(binfile_input_t *input,
         end_of_central_dir_64_t **stored_header) {
+    end_of_central_dir_64_t * header;
 
     *stored_header = NULL;
-    /* read rest of header */
-    if(fread(((uint32_t *)(header)) +1, sizeof(*header) - sizeof(header->end_of_central_dir_64_signature), 1, infile) > 0) {
-        char * extra = NULL;
-        uint64_t extra_length = (header->size_of_zip64_end_of_central_directory_record+12) - sizeof(*header);
-        //fprintf(stderr, "extra length %ld\n", extra_length);
-        *stored_header = (end_of_central_dir_64_t*) malloc(sizeof(*header) + extra_length);
-        /* copy the header */
-        memcpy(*stored_header, header, sizeof(*header));
-        /* read extra field*/
-        extra = (char *)((*stored_header) +1);
-        fread(extra, extra_length, 1, infile);
-    }
-    return 0; /* as we wrote nothing */
-}
-
-static int64_t process_end_of_central_dir(uint64_t offset, end_of_central_dir_t  *header, FILE *infile,
-        FILE *outfile,
-        struct rect *r,
+    header = input_peek(input, sizeof(*header));
+    if(header != NULL) {
+        //fprintf(stderr, "extra length %ld\n", header->size_of_zip64_end_of_central_directory_record + 12 - sizeof(*header));
+        *stored_header = header;
+        input_skip(input, header->size_of_zip64_end_of_central_directory_record + 12);
+    }
+    return (header != NULL) ? 0 : -1; /* as we wrote nothing */
+}
+
+static int64_t process_end_of_central_dir(binfile_input_t *input,
         end_of_central_dir_t **stored_header) {
+    end_of_central_dir_t * header;
 
     *stored_header = NULL;
-    /* read rest of header */
-    if(fread(((uint32_t *)(header)) +1, sizeof(*header) - sizeof(header->end_of_central_dir_signature), 1, infile) > 0) {
-        char * comment = NULL;
-        *stored_header = (end_of_central_dir_t*) malloc(sizeof(*header) + header->file_comment_length);
-        /* copy the header */
-        memcpy(*stored_header, header, sizeof(*header));
-        /* read comment*/
-        if(header->file_comment_length > 0) {
-            comment = (char *)((*stored_header) +1);
-            fread(comment, header->file_comment_length, 1, infile);
-            //fprintf(stderr,"Comment %.*s\n", header->file_comment_length, comment);
-        }
+    header = input_peek(input, sizeof(*header));
+    if(header != NULL) {
+        //fprintf(stderr,"Comment length %d\n", header->file_comment_length);
+        *stored_header = header;
+        input_skip(input, sizeof(*header) + header->file_comment_length);
     }
-    return 0; /* as we wrote nothing */
+    return (header != NULL) ? 0 : -1; /* as we wrote nothing */
 }
 
-static int64_t process_zip64_end_of_central_dir_locator(uint64_t offset, zip64_end_of_central_dir_locator_t *header,
-        FILE *infile,
-        FILE *outfile,
-        struct rect *r,
+static int64_t process_zip64_end_of_central_dir_locator(binfile_input_t *input,
         zip64_end_of_central_dir_locator_t **stored_header) {
+    zip64_end_of_central_dir_locator_t * header;
 
     *stored_header = NULL;
-    /* read rest of header */
-    if(fread(((uint32_t *)(header)) +1, sizeof(*header) - sizeof(header->zip64_end_of_central_dir_locator_signature), 1,
-             infile) > 0) {
-        *stored_header = (zip64_end_of_central_dir_locator_t*) malloc(sizeof(*header));
-        /* copy the header */
-        memcpy(*stored_header, header, sizeof(*header));
+    header = input_peek(input, sizeof(*header));
+    if(header != NULL) {
+        *stored_header = header;
+        input_skip(input, sizeof(*header));
     }
-    return 0; /* as we wrote nothing */
+    return (header != NULL) ? 0 : -1; /* as we wrote nothing */
+}
+
+static void process_placeholder(extract_sink_t *sinks, int count, tile_index_t *index, tile_index_entry_t *entry,
+                                run_statistics_t *stats) {
+    int i;
+    int keep_zerofile =1;
+    stats_tile(stats, index->names + entry->name_offset, entry->depth, 0, keep_zerofile ? count : 0);
+    for(i = 0; i < count; i ++)
+        count_tile(&(sinks[i]), entry->depth, 0);
+    if(!keep_zerofile)
+        return;
+    /* rejected tile: build the empty entry from the directory without touching the local header */
+    for(i = 0; i < count; i ++)
+        write_local_file(&(sinks[i]), tile_index_placeholder(index, entry, &(sinks[i].storage)), 0);
 }
 
-int process_binfile (FILE *infile, FILE* outfile, struct rect * r) {
-    int64_t written=0;
-    int64_t this_file;
+static void write_trailer(extract_sink_t *sink, run_statistics_t *stats) {
     uint64_t central_directory_offset;
     uint64_t central_directory_size;
-    zipfile_part_t part;
-    local_file_header_storage_t storage;
+    /* write central directory from the things we learned */
+    central_directory_offset = sink->written;
+    central_directory_size = write_central_directory(&(sink->storage), sink->outfile);
+    sink->written += central_directory_size;
+    /* write end of central directory structures */
+    sink->written += write_end_of_central_directory(sink->written, central_directory_offset, central_directory_size,
+                     &(sink->storage), sink->outfile);
+    stats->bytes_written += sink->written;
+    if(stats->verbose > 0)
+        fprintf(stderr, "processed %ld files%s%s\n", sink->storage.count, (sink->name != NULL) ? " for " : "",
+            (sink->name != NULL) ? sink->name : "");
+}
+
+/* the local file header at the input position is the one of entry */
+static int own_local_file(binfile_input_t *input, tile_index_t *index, tile_index_entry_t *entry) {
+    local_file_header_t * header = input_peek(input, sizeof(*header) + entry->name_length);
+    return (header != NULL) && (header->file_name_length == entry->name_length)
+           && (memcmp(header +1, index->names + entry->name_offset, entry->name_length) == 0);
+}
+
+/* move what the lane found so far to the statistics */
+static void collect_verified(verify_lane_t *verify, run_statistics_t *stats) {
+    stats->verified += verify->tiles;
+    stats->verified_bytes += verify->bytes;
+    stats->crc_mismatches += verify->mismatches;
+    stats->unverified += verify->unsupported;
+    verify->tiles = verify->bytes = verify->mismatches = verify->unsupported = 0;
+}
+
+/* everything before entry is written out in full */
+static int save_checkpoint(checkpoint_t *checkpoint, uint64_t entry, extract_sink_t *sinks, int count,
+                           clip_pool_t *clips, verify_lane_t *verify, run_statistics_t *stats) {
+    if(clips != NULL)
+        write_clipped(clips, 0, stats);
+    if(verify != NULL) {
+        verify_lane_drain(verify);
+        collect_verified(verify, stats);
+    }
+    checkpoint->entry = entry;
+    return checkpoint_save(checkpoint, sinks, count, stats);
+}
+
+/* the tiles some sink may keep by the quadtree cover of the areas, NULL to filter all */
+static uint8_t * select_tiles(tile_index_t *index, extract_sink_t *sinks, int count, run_statistics_t *stats) {
+    cover_area_t * areas;
+    uint8_t * candidates;
+    uint64_t selected;
+    int used = 0;
+    int i;
+
+    if(index->sorted == NULL)
+        return NULL;
+    areas = malloc(2 * count * sizeof(cover_area_t));
+    candidates = malloc(index->count +1);
+    if((areas == NULL) || (candidates == NULL)) {
+        free(areas);
+        free(candidates);
+        return NULL;
+    }
+    for(i = 0; i < count; i ++) {
+        areas[used].rect = sinks[i].area;
+        areas[used ++].depth = -1;
+        if(sinks[i].outer_depth > 0) {
+            areas[used].rect = sinks[i].outer;
+            areas[used ++].depth = sinks[i].outer_depth;
+        }
+    }
+    selected = tile_cover_select(index, areas, used, candidates);
+    free(areas);
+    if(stats->verbose > 0)
+        fprintf(stderr, "quadtree cover selected %ld of %ld tiles\n", selected, index->count);
+    return candidates;
+}
 
-    memset(&storage, 0, sizeof(storage));
-    storage.count =0;
+static int process_binfile_seekable (binfile_input_t *input, extract_sink_t *sinks, int count,
+                                     sink_filter_t *filter, tile_index_t *index, copy_plan_t *plan, clip_pool_t *clips,
+                                     verify_lane_t *verify, checkpoint_t *checkpoint, run_statistics_t *stats) {
+    uint64_t i;
+    uint64_t start = 0;
+    uint64_t next = 0;
+    local_file_header_t * header;
+    uint8_t * candidates;
+    int copying = 0;
+    int ret = 0;
+
+    if(checkpoint != NULL) {
+        int resumed = checkpoint_load(checkpoint, input->file, sinks, count, stats);
+        if(resumed < 0)
+            return 1;
+        if(checkpoint->entry > index->count) {
+            fprintf(stderr, "ERROR checkpoint beyond the last tile\n");
+            return 1;
+        }
+        start = checkpoint->entry;
+    }
 
-    while (fread(&(part.signature), sizeof(part.signature), 1, infile) > 0) {
-        local_file_header_t * file_header;
+    /* a plan only looks at the local headers */
+    for(i = 0; i < (uint64_t)count; i ++)
+        copying |= !sinks[i].plan;
+    /* tiles outside the cover are placeholders for every sink, the filter only sees the others */
+    stats_phase(stats, PHASE_FILTER);
+    candidates = select_tiles(index, sinks, count, stats);
+    /* the index is in directory order, which keeps the tile numbers NavIT looks tiles up by */
+    input_advise(input, 0, input->size, MADV_RANDOM);
+    for(i = start; i < index->count; i ++) {
+        tile_index_entry_t *entry = &(index->entries[i]);
+        if((checkpoint != NULL) && (stats->bytes_read >= checkpoint->next)
+                && (save_checkpoint(checkpoint, i, sinks, count, clips, verify, stats) != 0)) {
+            ret = 1;
+            break;
+        }
+        stats_phase(stats, PHASE_FILTER);
+        if(((candidates != NULL) && !candidates[i])
+                || filter_sinks(filter, &(entry->bbox), entry->depth, sinks, count)) {
+            stats_phase(stats, PHASE_HEADER);
+            process_placeholder(sinks, count, index, entry, stats);
+            continue;
+        }
+        /* get the next kept tile into the page cache while this one is copied */
+        for(next = (next > i) ? next : i +1; next < index->count; next ++) {
+            tile_index_entry_t *ahead = &(index->entries[next]);
+            if((candidates != NULL) && !candidates[next])
+                continue;
+            if(!filter_sinks(filter, &(ahead->bbox), ahead->depth, sinks, count)) {
+                input_advise(input, ahead->offset, (copying ? ahead->compressed_size : 0) + sizeof(local_file_header_t),
+                             MADV_WILLNEED);
+                break;
+            }
+        }
+        if((input_seek(input, entry->offset) != 0)
+                || ((header = input_peek(input, sizeof(header->local_file_header_signature))) == NULL)
+                || (header->local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)) {
+            fprintf(stderr, "ERROR no local file header at offset %ld\n", entry->offset);
+            ret = 1;
+            break;
+        }
+        if((entry->compressed_size == 0) && !own_local_file(input, index, entry)) {
+            /* empty tile of a compact binfile, the local header is another one's */
+            process_placeholder(sinks, count, index, entry, stats);
+            continue;
+        }
+        if(process_local_file(input, sinks, count, filter, index, entry, plan, clips, verify, stats) < 0) {
+            fprintf(stderr, "ERROR reading tile at offset %ld\n", entry->offset);
+            ret = 1;
+            break;
+        }
+    }
+    free(candidates);
+    return ret;
+}
+
+/* the header at the input position holds up beyond its signature */
+static int plausible_header(binfile_input_t *input, uint32_t signature) {
+    if(signature == LOCAL_FILE_HEADER_SIGNATURE) {
+        local_file_header_t * header = input_peek(input, sizeof(*header));
+        return (header != NULL) && ((header = input_peek(input, sizeof(*header) + header->file_name_length)) != NULL)
+               && plausible_local_file_header(header);
+    } else {
+        central_directory_header_t * header = input_peek(input, sizeof(*header));
+        return (header != NULL) && ((header = input_peek(input, sizeof(*header) + header->file_name_length)) != NULL)
+               && plausible_central_directory_header(header);
+    }
+}
+
+/* No record starts at the input position: a data descriptor, padding or damage.
+ * Look for the next local file or directory header, a window at a time with
+ * memchr() for the P of PK, and go on there if the header holds up. */
+static void resync(binfile_input_t *input, run_statistics_t *stats) {
+    uint64_t start = input->position;
+    uint64_t size;
+    char * window;
+
+    input_skip(input, 1);
+    while((window = input_peek_some(input, RESYNC_WINDOW, &size)) != NULL) {
+        uint64_t offset = 0;
+        uint32_t signature = 0;
+        char * p;
+        while((p = memchr(window + offset, 'P', size - offset)) != NULL) {
+            offset = p - window;
+            if(size - offset < 4)
+                break;
+            memcpy(&signature, p, sizeof(signature));
+            if((signature == LOCAL_FILE_HEADER_SIGNATURE) || (signature == CENTRAL_DIRECTORY_HEADER_SIGNATURE))
+                break;
+            offset ++;
+        }
+        if((p != NULL) && (size - offset >= 4)) {
+            input_skip(input, offset);
+            if(plausible_header(input, signature))
+                break;
+            input_skip(input, 1);
+        } else if(size < RESYNC_WINDOW) {
+            /* the end of the input */
+            input_skip(input, size);
+            break;
+        } else {
+            /* keep a P that may start a signature across the window */
+            input_skip(input, (p != NULL) ? offset : size);
+        }
+    }
+    stats->gaps ++;
+    stats->gap_bytes += input->position - start;
+    fprintf(stderr, "skipped %ld bytes of unknown data at offset %ld\n", input->position - start, start);
+}
+
+/* The input ends inside the record at start: count it as damage and stop there. */
+static void damaged_tail(binfile_input_t *input, uint64_t start, run_statistics_t *stats) {
+    uint64_t size;
+
+    while(input_peek_some(input, RESYNC_WINDOW, &size) != NULL)
+        input_skip(input, size);
+    stats->gaps ++;
+    stats->gap_bytes += input->position - start;
+    fprintf(stderr, "ERROR damaged tail, %ld bytes of a truncated record at offset %ld\n",
+            input->position - start, start);
+}
+
+static int process_binfile_stream (binfile_input_t *input, extract_sink_t *sinks, int count,
+                                   sink_filter_t *filter, copy_plan_t *plan, clip_pool_t *clips, verify_lane_t *verify,
+                                   run_statistics_t *stats) {
+    uint32_t signature;
+    void * peek;
+    uint64_t local_files = 0;
+    uint64_t directory_entries = 0;
+    uint64_t record;
+    int64_t done = 0;
+
+    input_advise(input, 0, input->size, MADV_SEQUENTIAL);
+    while ((peek = input_peek(input, sizeof(signature))) != NULL) {
         central_directory_header_t * central_directory_header;
         zip64_end_of_central_dir_locator_t * zip64_end_of_central_dir_locator;
         end_of_central_dir_64_t * end_of_central_dir_64;
         end_of_central_dir_t * end_of_central_dir;
-        switch(part.signature) {
+        stats_phase(stats, PHASE_HEADER);
+        record = input->position;
+        /* records follow each other at any byte */
+        memcpy(&signature, peek, sizeof(signature));
+        switch(signature) {
         case LOCAL_FILE_HEADER_SIGNATURE:
             //fprintf(stderr, "Got LOCAL FILE HEADER\n");
-            this_file = process_local_file(written,&(part.local_file_header),infile, outfile, r, &file_header);
-            if(file_header != NULL) {
-                /* remember new file header and old written value */
-                remember_local_file (&storage, file_header, written);
-                written += this_file;
-            }
+            done = process_local_file(input, sinks, count, filter, NULL, NULL, plan, clips, verify, stats);
+            local_files ++;
             break;
         case CENTRAL_DIRECTORY_HEADER_SIGNATURE:
             //fprintf(stderr, "Got CENTRAL DIRCTORY HEADER\n");
-            process_central_directory_header(written, &(part.central_directory_header),infile, outfile, r,
-                                             &central_directory_header);
-            if(central_directory_header != NULL)
-                free(central_directory_header);
+            done = process_central_directory_header(input, &central_directory_header);
+            directory_entries ++;
             break;
         case END_OF_CENTRAL_DIR_64_SIGNATURE:
             //fprintf(stderr, "Got ZIP64 END OF CENTRAL DIRECTORY\n");
-            process_end_of_central_dir_64(written, &(part.end_of_central_dir_64),infile, outfile, r,
-                                          &end_of_central_dir_64);
-            if(end_of_central_dir_64 != NULL)
-                free(end_of_central_dir_64);
+            done = process_end_of_central_dir_64(input, &end_of_central_dir_64);
             break;
         case ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIGNATURE:
             //fprintf(stderr, "Got ZIP64 CENTRAL DIECTORY LOCATOR\n");
-            process_zip64_end_of_central_dir_locator(written, &(part.zip64_end_of_central_dir_locator),infile, outfile, r,
-                    &zip64_end_of_central_dir_locator);
-            if(zip64_end_of_central_dir_locator != NULL)
-                free(zip64_end_of_central_dir_locator);
+            done = process_zip64_end_of_central_dir_locator(input, &zip64_end_of_central_dir_locator);
             break;
         case END_OF_CENTRAL_DIR_SIGNATURE:
             //fprintf(stderr, "Got END OF CENTRAL DIRECTORY\n");
-            process_end_of_central_dir(written, &(part.end_of_central_dir),infile, outfile, r,
-                                       &end_of_central_dir);
-            if(end_of_central_dir != NULL)
-                free(end_of_central_dir);
+            done = process_end_of_central_dir(input, &end_of_central_dir);
             break;
         default:
-            //fprintf(stderr, "Got unknown header %x\n", part.signature);
+            //fprintf(stderr, "Got unknown header %x\n", signature);
+            resync(input, stats);
             break;
         }
+        /* the record goes on beyond the end of the input */
+        if(done < 0) {
+            damaged_tail(input, record, stats);
+            return 1;
+        }
+    }
+    /* compact binfiles have fewer local files than entries, the missing ones are lost */
+    if((directory_entries > local_files) && (stats->gaps > 0)) {
+        fprintf(stderr, "ERROR %ld of %ld tiles lost in damaged data\n", directory_entries - local_files,
+                directory_entries);
+        return 1;
+    } else if(directory_entries > local_files) {
+        fprintf(stderr, "ERROR %ld of %ld tiles share local file headers, give the binfile as a regular file\n",
+                directory_entries - local_files, directory_entries);
+        return 1;
     }
-    /* write central directory from the things we learned */
-    central_directory_offset = written;
-    central_directory_size = write_central_directory(&storage, outfile);
-    written += central_directory_size;
-    /* write end of central directory structures */
-    written += write_end_of_central_directory(written, central_directory_offset, central_directory_size, &storage, outfile);
-    fprintf(stderr, "processed %ld files\n",storage.count);
-
-    free_storage(&storage);
     return 0;
 }
 
+/* tile list from the sidecar if it matches the input, from the central directory otherwise */
+static int load_tile_index(binfile_input_t *input, const char *index_path, tile_index_t *index,
+                           run_statistics_t *stats) {
+    struct stat st;
+    central_directory_t directory;
+    int ret;
 
+    if((index_path != NULL) && (fstat(fileno(input->file), &st) == 0)
+            && (tile_index_open(index, index_path, &st) == 0))
+        ret = 0;
+    else if(read_central_directory(input, &directory) == 0) {
+        stats->bytes_read += directory.size;
+        ret = tile_index_from_directory(index, &directory);
+        free_central_directory(&directory);
+    } else
+        return -1;
+    /* without the sorted names every tile goes through the filter */
+    if(ret == 0)
+        tile_index_sort(index);
+    return ret;
+}
 
-int main (int argc, char ** argv) {
-    int option_index=1;
-    FILE * infile = stdin;
-    FILE * outfile = stdout;
-    extractor_parameters_t p;
-    char * endp;
+/* positioned copies need random access on both sides */
+static int can_copy_parallel(binfile_input_t *input, extract_sink_t *sinks, int count) {
+    struct stat st;
+    int i;
+    if(!input->seekable)
+        return 0;
+    for(i = 0; i < count; i ++) {
+        if((fstat(fileno(sinks[i].outfile), &st) != 0) || !S_ISREG(st.st_mode)
+                || (fcntl(fileno(sinks[i].outfile), F_GETFL) & O_APPEND))
+            return 0;
+    }
+    return 1;
+}
 
-    fprintf(stderr, "NavIT binfile extractor\n"
-            "Created by Metalstrolch 2019\n"
-            "This is free software; see the source for copying conditions.  There is NO\n"
-            "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n");
+/* let the sinks write through the pipeline, returns their own streams */
+static FILE ** start_pipeline(pipeline_t *pipeline, int io, extract_sink_t *sinks, int count, int verbose) {
+    FILE ** outfiles;
+    int i;
 
-    if((argc - option_index) != 4) {
-        usage();
-        exit(1);
+    if((io == PIPELINE_SYNC) || (pipeline_start(pipeline, io) != 0))
+        return NULL;
+    outfiles = calloc(count, sizeof(FILE *));
+    for(i = 0; i < count; i ++) {
+        FILE * stream;
+        /* callback outputs have no descriptor */
+        if(fileno(sinks[i].outfile) < 0)
+            continue;
+        fflush(sinks[i].outfile);
+        stream = pipeline_open(pipeline, fileno(sinks[i].outfile));
+        if(stream != NULL) {
+            outfiles[i] = sinks[i].outfile;
+            sinks[i].outfile = stream;
+        }
     }
+    if(verbose > 0)
+        fprintf(stderr, "writing asynchronously with %s\n",
+                (pipeline->backend == PIPELINE_URING) ? "io_uring" : "a writer thread");
+    return outfiles;
+}
 
-    p.lon_bottom_left = strtod(argv[option_index], &endp);
-    if(endp != (argv[option_index] + strlen(argv[option_index]))) {
-        usage();
-        exit(1);
+static int stop_pipeline(pipeline_t *pipeline, FILE **outfiles, extract_sink_t *sinks, int count) {
+    int ret = 0;
+    int i;
+    for(i = 0; i < count; i ++) {
+        if(outfiles[i] == NULL)
+            continue;
+        if(fclose(sinks[i].outfile) != 0) {
+            fprintf(stderr, "ERROR writing%s%s: %s\n", (sinks[i].name != NULL) ? " " : "",
+                    (sinks[i].name != NULL) ? sinks[i].name : "", strerror(errno));
+            ret = 1;
+        }
+        sinks[i].outfile = outfiles[i];
     }
-    p.lat_bottom_left = strtod(argv[option_index +1], &endp);
-    if(endp != (argv[option_index +1] + strlen(argv[option_index +1]))) {
-        usage();
-        exit(1);
+    free(outfiles);
+    pipeline_stop(pipeline);
+    return ret;
+}
+
+/* index may be NULL, then it is loaded from index_path or the central directory */
+static int process_input (binfile_input_t *input, tile_index_t *index, const char *index_path,
+                          extract_sink_t *sinks, int count, int threads, int io, checkpoint_t *checkpoint,
+                          run_statistics_t *stats) {
+    int ret;
+    int i;
+    tile_index_t own_index;
+    run_statistics_t own_stats;
+    sink_filter_t filter;
+    copy_plan_t plan;
+    copy_plan_t * deferred = NULL;
+    clip_pool_t pool;
+    clip_pool_t * clips = NULL;
+    verify_lane_t lane;
+    verify_lane_t * verify = NULL;
+    pipeline_t pipeline;
+    FILE ** outfiles;
+
+    if(stats == NULL) {
+        stats_init(&own_stats, 0, 0);
+        stats = &own_stats;
     }
-    p.lon_top_right = strtod(argv[option_index +2], &endp);
-    if(endp != (argv[option_index +2] + strlen(argv[option_index +2]))) {
-        usage();
-        exit(1);
+    stats_phase(stats, PHASE_HEADER);
+    memset(&plan, 0, sizeof(plan));
+    for(i = 0; i < count; i ++) {
+        memset(&(sinks[i].storage), 0, sizeof(sinks[i].storage));
+        sinks[i].written = 0;
+        sinks[i].placeholder = -1;
+        memset(sinks[i].kept, 0, sizeof(sinks[i].kept));
+        memset(sinks[i].placeholders, 0, sizeof(sinks[i].placeholders));
+        if((sinks[i].margin >= 0) || sinks[i].recompress)
+            clips = &pool;
+    }
+    if(sink_filter_init(&filter, sinks, count) != 0) {
+        fprintf(stderr, "ERROR no memory for the areas of %d outputs\n", count);
+        sink_filter_free(&filter);
+        return 1;
+    }
+    if(clips != NULL)
+        clip_pool_start(clips, (threads > 1) ? threads : sysconf(_SC_NPROCESSORS_ONLN));
+    if(stats->verify) {
+        verify = &lane;
+        /* inflating is slower than copying, so it gets all CPUs but ours */
+        verify_lane_start(verify, (threads > 1) ? threads : sysconf(_SC_NPROCESSORS_ONLN) -1);
+    }
+    if((threads > 1) && (checkpoint == NULL)) {
+        /* lay out the output first, copy the tile data in parallel afterwards */
+        if(can_copy_parallel(input, sinks, count))
+            deferred = &plan;
+        else if(stats->verbose > 0)
+            fprintf(stderr, "parallel copy needs regular files for input and output, copying serially\n");
+    }
+    /* the kernel copies a mapped input best on its own, the workers write by position anyway.
+     * With a single CPU the writes can't overlap anything but waiting for the device. */
+    if(io == PIPELINE_AUTO)
+        io = ((input->map == NULL) && (sysconf(_SC_NPROCESSORS_ONLN) > 1)) ? PIPELINE_URING : PIPELINE_SYNC;
+    /* a checkpoint syncs the outputs, so they have to be written by now */
+    if((deferred != NULL) || (checkpoint != NULL))
+        io = PIPELINE_SYNC;
+    outfiles = start_pipeline(&pipeline, io, sinks, count, stats->verbose);
+    /* random access: read the directory first, only touch what we keep */
+    if(index != NULL) {
+        ret = process_binfile_seekable(input, sinks, count, &filter, index, deferred, clips, verify, checkpoint, stats);
+        stats->bytes_skipped = input->size - stats->bytes_read;
+    } else if(input->seekable && (load_tile_index(input, index_path, &own_index, stats) == 0)) {
+        ret = process_binfile_seekable(input, sinks, count, &filter, &own_index, deferred, clips, verify, checkpoint, stats);
+        tile_index_free(&own_index);
+        stats->bytes_skipped = input->size - stats->bytes_read;
+    } else if(checkpoint != NULL) {
+        fprintf(stderr, "ERROR checkpoints need a seekable binfile with a central directory\n");
+        ret = 1;
+    } else {
+        if(input->seekable) {
+            if(stats->verbose > 0)
+                fprintf(stderr, "no usable central directory, streaming\n");
+            input_seek(input, 0);
+        }
+        ret = process_binfile_stream(input, sinks, count, &filter, deferred, clips, verify, stats);
+        stats->bytes_skipped = input->position - stats->bytes_read;
+    }
+    stats_phase(stats, PHASE_COPY);
+    if(verify != NULL) {
+        verify_lane_finish(verify);
+        collect_verified(verify, stats);
+        if(stats->crc_mismatches > 0)
+            ret = 1;
+    }
+    if(clips != NULL) {
+        /* the jobs may still look at the input */
+        clip_pool_finish(clips);
+        if(ret == 0)
+            write_clipped(clips, 0, stats);
+        clip_pool_free(clips);
+        if((stats->rewritten > 0) && (stats->verbose > 0))
+            fprintf(stderr, "rewrote %ld tiles, dropped %ld of %ld items, %ld -> %ld bytes\n", stats->rewritten,
+                    stats->items_dropped, stats->items, stats->rewritten_before, stats->rewritten_after);
+    }
+    stats_phase(stats, PHASE_DIRECTORY);
+    for(i = 0; i < count; i ++) {
+        if(ret == 0)
+            write_trailer(&(sinks[i]), stats);
+        free_storage(&(sinks[i].storage));
+        if(deferred != NULL) {
+            fflush(sinks[i].outfile);
+            preallocate_output(fileno(sinks[i].outfile), ftello(sinks[i].outfile));
+        }
     }
-    p.lat_top_right = strtod(argv[option_index +3], &endp);
-    if(endp != (argv[option_index +3] + strlen(argv[option_index +3]))) {
-        usage();
-        exit(1);
+    if((outfiles != NULL) && (stop_pipeline(&pipeline, outfiles, sinks, count) != 0))
+        ret = 1;
+    stats_phase(stats, PHASE_COPY);
+    if((ret == 0) && (deferred != NULL)) {
+        if(stats->verbose > 0)
+            fprintf(stderr, "copying %ld bytes in %ld pieces with %d threads\n", plan.bytes, plan.count, threads);
+        ret = copy_plan_run(&plan, threads, &(stats->copy));
     }
-    /* same order as the filename from planet extractor */
-    getmercator(p.lon_bottom_left,p.lat_bottom_left,p.lon_top_right,p.lat_top_right, &p.area);
+    copy_plan_free(&plan);
+    sink_filter_free(&filter);
+    stats_phase(stats, PHASE_NONE);
+    if(stats->verbose > 0)
+        print_copy_statistics(&(stats->copy));
+    if((stats->verbose > 0) && (verify != NULL))
+        fprintf(stderr, "verified %ld tiles, %ld crc mismatches, %ld without crc\n", stats->verified,
+                stats->crc_mismatches, stats->unverified);
+    return ret;
+}
+
+/* extract all sinks in one pass over the input, stats may be NULL. io is an
+ * enum pipeline_backend. Progress goes to stderr if stats->verbose is set,
+ * errors always. */
+int process_binfile (FILE *infile, extract_sink_t *sinks, int count, const char *index_path, int threads,
+                     int io, run_statistics_t *stats) {
+    binfile_input_t input;
+    int ret;
+
+    if(input_open(&input, infile) != 0) {
+        fprintf(stderr, "ERROR opening input: %s\n", strerror(errno));
+        return 1;
+    }
+    ret = process_input(&input, NULL, index_path, sinks, count, threads, io, NULL, stats);
+    input_close(&input);
+    return ret;
+}
+
+/* same, checkpointing along the way and resuming from the checkpoint if there
+ * is one. The outputs must be regular files opened without truncating them. */
+int process_binfile_resumable (FILE *infile, extract_sink_t *sinks, int count, const char *index_path, int threads,
+                               checkpoint_t *checkpoint, run_statistics_t *stats) {
+    binfile_input_t input;
+    int ret;
+
+    if(input_open(&input, infile) != 0) {
+        fprintf(stderr, "ERROR opening input: %s\n", strerror(errno));
+        return 1;
+    }
+    ret = process_input(&input, NULL, index_path, sinks, count, threads, PIPELINE_SYNC, checkpoint, stats);
+    input_close(&input);
+    if(ret == 0)
+        checkpoint_remove(checkpoint);
+    return ret;
+}
 
-    fprintf(stderr, "Extract area (lon %f, lat %f) - (lon %f, lat %f)\n",p.lon_bottom_left, p.lat_bottom_left,
-            p.lon_top_right, p.lat_top_right);
-    fprintf(stderr, "NavIT Mercator (%d, %d) - (%d, %d)\n", p.area.l.x, p.area.l.y, p.area.h.x, p.area.h.y);
-    return process_binfile (infile, outfile, &p.area);
+/* same on a mapped input and its index, which are only read. Several of these
+ * can run on the same map, each with its own copy of the input and its own
+ * FILE on the binfile. */
+int process_binfile_indexed (binfile_input_t *input, tile_index_t *index, extract_sink_t *sinks, int count,
+                             int threads, int io, run_statistics_t *stats) {
+    return process_input(input, index, NULL, sinks, count, threads, io, NULL, stats);
 }
 
+/* write the tile index sidecar of the binfile on infile */
+int create_index (FILE *infile, FILE *outfile) {
+    int ret;
+    struct stat st;
+    binfile_input_t input;
+    central_directory_t directory;
+    tile_index_t index;
+
+    if(input_open(&input, infile) != 0) {
+        fprintf(stderr, "ERROR opening input: %s\n", strerror(errno));
+        return 1;
+    }
+    if(!input.seekable || (fstat(fileno(infile), &st) != 0)) {
+        fprintf(stderr, "ERROR indexing needs the binfile as a regular file on stdin\n");
+        input_close(&input);
+        return 1;
+    }
+    if(read_central_directory(&input, &directory) != 0) {
+        fprintf(stderr, "ERROR no usable central directory\n");
+        input_close(&input);
+        return 1;
+    }
+    ret = tile_index_from_directory(&index, &directory);
+    free_central_directory(&directory);
+    if(ret == 0) {
+        ret = tile_index_write(&index, &st, outfile);
+        fprintf(stderr, "indexed %ld files\n", index.count);
+        tile_index_free(&index);
+    }
+    input_close(&input);
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef __extractor_h
+#define __extractor_h
+#include <stdio.h>
+#include <stdint.h>
+
+#include "zipfile.h"
+#include "input.h"
+#include "tileindex.h"
+#include "stats.h"
+#include "map.h"
+
+/* one output of an extraction run */
+typedef struct extract_sink extract_sink_t;
+struct extract_sink {
+    char * name;
+    FILE * outfile;
+    struct rect area;
+    struct polygon_area * polygon; /* exact area inside the bbox, or NULL */
+    struct rect outer; /* overview area around the area */
+    int outer_depth; /* tiles down to this depth are kept in outer as well, 0 without outer */
+    local_file_header_storage_t storage;
+    int64_t written;
+    int margin; /* clip border tiles to the items this close to the area, -1 to copy them whole */
+    int keep; /* filter decision for the current tile */
+    int clip; /* current tile is kept, but only partly inside the area */
+    int overview; /* current tile is shallow enough for the outer area */
+    int recompress; /* deflate kept tiles again as small as zlib gets them */
+    int compact; /* all placeholders share one empty local file header */
+    int64_t placeholder; /* offset of that header, -1 until written */
+    int plan; /* only count what would be written, tile data is skipped */
+    uint64_t kept[STATS_DEPTHS];         /* tiles with data */
+    uint64_t placeholders[STATS_DEPTHS]; /* tiles as empty entries */
+};
+
+int filter_file(local_file_header_t * header, extract_sink_t *sinks, int count);
+int process_binfile (FILE *infile, extract_sink_t *sinks, int count, const char *index_path, int threads,
+                     int io, run_statistics_t *stats);
+struct checkpoint;
+int process_binfile_resumable (FILE *infile, extract_sink_t *sinks, int count, const char *index_path, int threads,
+                               struct checkpoint *checkpoint, run_statistics_t *stats);
+int process_binfile_indexed (binfile_input_t *input, tile_index_t *index, extract_sink_t *sinks, int count,
+                             int threads, int io, run_statistics_t *stats);
+int create_index (FILE *infile, FILE *outfile);
+#endif
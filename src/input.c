@@ -0,0 +1,306 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "input.h"
+
+/* pipes are read away in pieces of this size */
+#define INPUT_DISCARD_CHUNK (1024*1024)
+
+int input_open(binfile_input_t * input, FILE * file) {
+    struct stat st;
+    memset(input, 0, sizeof(*input));
+    input->file = file;
+    /* callback streams have no descriptor, they are read like a pipe */
+    if(fileno(file) < 0)
+        return 0;
+    if(fstat(fileno(file), &st) != 0)
+        return -1;
+    /* zip offsets are relative to the start of the file */
+    input->seekable = S_ISREG(st.st_mode) && (ftello(file) == 0);
+    if(input->seekable && (st.st_size > 0)) {
+        input->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+        if(input->map == MAP_FAILED)
+            input->map = NULL;
+        else
+            input->size = st.st_size;
+    }
+    return 0;
+}
+
+/* a view of the map of another input with a position of its own. file is another open
+ * file description of the same binfile for the kernel copies. Don't close it. */
+void input_share(binfile_input_t * input, binfile_input_t * shared, FILE * file) {
+    memset(input, 0, sizeof(*input));
+    input->file = file;
+    input->seekable = shared->seekable;
+    input->map = shared->map;
+    input->size = shared->size;
+}
+
+void input_close(binfile_input_t * input) {
+    if(input->map != NULL)
+        munmap(input->map, input->size);
+    if(input->buffer != NULL)
+        free(input->buffer);
+    memset(input, 0, sizeof(*input));
+}
+
+void * input_peek(binfile_input_t * input, uint64_t size) {
+    if(input->map != NULL) {
+        if(input->position + size > input->size)
+            return NULL;
+        return input->map + input->position;
+    }
+    if(size > input->buffer_size) {
+        char * buffer = realloc(input->buffer, size);
+        if(buffer == NULL)
+            return NULL;
+        input->buffer = buffer;
+        input->buffer_size = size;
+    }
+    if(input->buffered < size)
+        input->buffered += fread(input->buffer + input->buffered, 1, size - input->buffered, input->file);
+    if(input->buffered < size)
+        return NULL;
+    return input->buffer;
+}
+
+void * input_peek_some(binfile_input_t * input, uint64_t size, uint64_t * available) {
+    void * data;
+    if(input->map != NULL) {
+        *available = (input->position + size > input->size) ? input->size - input->position : size;
+        return (*available > 0) ? input->map + input->position : NULL;
+    }
+    data = input_peek(input, size);
+    if(data != NULL) {
+        *available = size;
+        return data;
+    }
+    /* input_peek keeps what there was */
+    *available = input->buffered;
+    return (*available > 0) ? input->buffer : NULL;
+}
+
+int input_read(binfile_input_t * input, void * buffer, uint64_t size) {
+    void * data;
+    if((input->map == NULL) && (input->buffered == 0)) {
+        /* nothing peeked, go straight to the destination */
+        if(fread(buffer, 1, size, input->file) != size)
+            return -1;
+        input->position += size;
+        return 0;
+    }
+    data = input_peek(input, size);
+    if(data == NULL)
+        return -1;
+    memcpy(buffer, data, size);
+    return input_skip(input, size);
+}
+
+/* read data away through the peek buffer, nothing may be buffered */
+static int input_discard(binfile_input_t * input, uint64_t size) {
+    while(size > 0) {
+        uint64_t chunk = size;
+        if(chunk > INPUT_DISCARD_CHUNK)
+            chunk = INPUT_DISCARD_CHUNK;
+        if(input_peek(input, chunk) == NULL)
+            return -1;
+        input->buffered = 0;
+        size -= chunk;
+    }
+    return 0;
+}
+
+int input_skip(binfile_input_t * input, uint64_t size) {
+    if(input->map != NULL) {
+        if(input->position + size > input->size)
+            return -1;
+        input_advise(input, input->position, size, MADV_DONTNEED);
+        input->position += size;
+        return 0;
+    }
+    if(size <= input->buffered) {
+        input->buffered -= size;
+        memmove(input->buffer, input->buffer + size, input->buffered);
+    } else {
+        uint64_t rest = size - input->buffered;
+        input->buffered = 0;
+        /* seek over data if we can, read it away if we are on a pipe */
+        if(!input->seekable || (fseeko(input->file, rest, SEEK_CUR) != 0)) {
+            if(input_discard(input, rest) != 0)
+                return -1;
+        }
+    }
+    input->position += size;
+    return 0;
+}
+
+int input_seek(binfile_input_t * input, uint64_t offset) {
+    if(input->map != NULL) {
+        if(offset > input->size)
+            return -1;
+        input->position = offset;
+        return 0;
+    }
+    if(!input->seekable || (fseeko(input->file, offset, SEEK_SET) != 0))
+        return -1;
+    input->buffered = 0;
+    input->position = offset;
+    return 0;
+}
+
+/* copy through memory: the peek buffer, or the map itself */
+static uint64_t input_copy_buffered(binfile_input_t * input, uint64_t size, FILE ** outfiles, int count,
+                                   copy_statistics_t * stats) {
+    uint64_t bsize = 10*1024*1024;
+    uint64_t copied = 0;
+    int i;
+
+    while(copied < size) {
+        uint64_t chunk = size - copied;
+        char * data;
+        if(chunk > bsize)
+            chunk = bsize;
+        data = input_peek(input, chunk);
+        if(data == NULL) {
+            fprintf(stderr, "ERROR reading: %s\n", ferror(input->file) ? strerror(errno) : "end of file");
+            return -1;
+        }
+        for(i = 0; i < count; i ++) {
+            if(fwrite(data, 1, chunk, outfiles[i]) != chunk) {
+                fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+                return -1;
+            }
+        }
+        if(stats != NULL)
+            stats->bytes[COPY_METHOD_BUFFERED] += chunk * count;
+        input_skip(input, chunk);
+        copied += chunk;
+    }
+    return size;
+}
+
+uint64_t input_copy(binfile_input_t * input, uint64_t size, FILE * outfile, copy_statistics_t * stats) {
+    uint64_t copied = 0;
+    /* no descriptor for the kernel to copy to, e.g. a pipeline stream */
+    if(fileno(outfile) < 0)
+        return input_copy_buffered(input, size, &outfile, 1, stats);
+    if(input->map != NULL) {
+        if(input->position + size > input->size)
+            return -1;
+        /* let the kernel pick the data up by offset, the descriptor is still there */
+        if(fseeko(input->file, input->position, SEEK_SET) != 0)
+            return -1;
+        input_advise(input, input->position, size, MADV_WILLNEED);
+        if(copy_file_data(size, input->file, outfile, stats) != size)
+            return -1;
+        input->position += size;
+        return size;
+    }
+    if(input->buffered > 0) {
+        /* hand out what was peeked first */
+        copied = input->buffered;
+        if(copied > size)
+            copied = size;
+        if(fwrite(input->buffer, 1, copied, outfile) != copied)
+            return -1;
+        if(stats != NULL)
+            stats->bytes[COPY_METHOD_BUFFERED] += copied;
+        input->buffered -= copied;
+        memmove(input->buffer, input->buffer + copied, input->buffered);
+    }
+    if(copy_file_data(size - copied, input->file, outfile, stats) != size - copied)
+        return -1;
+    input->position += size;
+    return size;
+}
+
+/* copy the same data to several outputs, reading it from the input only once */
+uint64_t input_copy_fanout(binfile_input_t * input, uint64_t size, FILE ** outfiles, int count,
+                           copy_statistics_t * stats) {
+    uint64_t start = input->position;
+    int i;
+
+    if(count == 1)
+        return input_copy(input, size, outfiles[0], stats);
+    if(input->seekable) {
+        /* the first copy pulls the data into the page cache, the others are served from there */
+        for(i = 0; i < count; i ++) {
+            if((input_seek(input, start) != 0) || (input_copy(input, size, outfiles[i], stats) != size))
+                return -1;
+        }
+        return size;
+    }
+    return input_copy_buffered(input, size, outfiles, count, stats);
+}
+
+static int file_advice(int advice) {
+    switch(advice) {
+    case MADV_WILLNEED:
+        return POSIX_FADV_WILLNEED;
+    case MADV_DONTNEED:
+        return POSIX_FADV_DONTNEED;
+    case MADV_SEQUENTIAL:
+        return POSIX_FADV_SEQUENTIAL;
+    case MADV_RANDOM:
+        return POSIX_FADV_RANDOM;
+    }
+    return POSIX_FADV_NORMAL;
+}
+
+void input_advise(binfile_input_t * input, uint64_t offset, uint64_t size, int advice) {
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start;
+    uint64_t end;
+    if(input->map == NULL)
+        return;
+    if(offset + size > input->size)
+        size = input->size - offset;
+    if(advice == MADV_DONTNEED) {
+        /* only pages entirely inside the range, the neighbours are still in use */
+        start = (offset + page -1) / page * page;
+        end = (offset + size) / page * page;
+    } else {
+        start = offset / page * page;
+        end = offset + size;
+    }
+    /* tiny tiles aren't worth a syscall */
+    if((end <= start) || ((advice == MADV_WILLNEED) && (end - start < page)))
+        return;
+    if((advice == MADV_RANDOM) || (advice == MADV_SEQUENTIAL))
+        input->access = advice;
+    madvise(input->map + start, end - start, advice);
+    /* the kernel copies read through the descriptor, tell its page cache too. Only
+     * drop what a sequential pass has read past, a random one never reads skipped
+     * tiles and the next run may want the cached ones. */
+    if((advice != MADV_DONTNEED) || (input->access == MADV_SEQUENTIAL))
+        posix_fadvise(fileno(input->file), start, end - start, file_advice(advice));
+}
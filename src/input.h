@@ -0,0 +1,60 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __input_h
+#define __input_h
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "zipfile.h"
+
+/* Regular files are mapped and parsed in place. Pipes are read through stdio,
+ * with the bytes asked for by input_peek kept in a buffer until skipped. */
+typedef struct binfile_input binfile_input_t;
+struct binfile_input {
+    FILE * file;
+    int seekable;
+    char * map;        /* whole input, NULL if not mapped */
+    uint64_t size;     /* size of the map */
+    uint64_t position; /* logical read position */
+    char * buffer;     /* stdio backend: peeked bytes starting at position */
+    uint64_t buffered;
+    uint64_t buffer_size;
+    int access;        /* MADV_RANDOM or MADV_SEQUENTIAL, as given for the whole input */
+};
+
+int input_open(binfile_input_t * input, FILE * file);
+void input_share(binfile_input_t * input, binfile_input_t * shared, FILE * file);
+void input_close(binfile_input_t * input);
+void * input_peek(binfile_input_t * input, uint64_t size);
+/* like input_peek, but fewer bytes at the end of the input, their number in available */
+void * input_peek_some(binfile_input_t * input, uint64_t size, uint64_t * available);
+int input_read(binfile_input_t * input, void * buffer, uint64_t size);
+int input_skip(binfile_input_t * input, uint64_t size);
+int input_seek(binfile_input_t * input, uint64_t offset);
+uint64_t input_copy(binfile_input_t * input, uint64_t size, FILE * outfile, copy_statistics_t * stats);
+uint64_t input_copy_fanout(binfile_input_t * input, uint64_t size, FILE ** outfiles, int count,
+                           copy_statistics_t * stats);
+/* advice is a MADV_* value, passed on to the page cache of the descriptor as well.
+ * MADV_RANDOM and MADV_SEQUENTIAL split the mapping, so only give them for the
+ * whole input. */
+void input_advise(binfile_input_t * input, uint64_t offset, uint64_t size, int advice);
+#endif
@@ -0,0 +1,659 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <fcntl.h>
+
+#include "extractor.h"
+#include "checkpoint.h"
+#include "pipeline.h"
+#include "daemon.h"
+#include "delta.h"
+#include "merge.h"
+#include "map.h"
+
+typedef struct extractor_parameters extractor_parameters_t;
+struct extractor_parameters {
+    struct rect area;
+    double lat_bottom_left;
+    double lon_bottom_left;
+    double lat_top_right;
+    double lon_top_right;
+};
+
+/* tiles this shallow hold items of about 150 km and more */
+#define OUTER_DEPTH 8
+
+static void usage (void) {
+    fprintf(stderr,"\n"
+            " usage: navit_binfile_extractor [coordinates] \n"
+            "        navit_binfile_extractor -p <polygon file>\n"
+            "        navit_binfile_extractor -f <jobs file>\n"
+            "        navit_binfile_extractor index < <binfile> > <index file>\n"
+            "        navit_binfile_extractor serve [-i <index file>] [-j <requests>] <socket> <binfile>\n"
+            "        navit_binfile_extractor request <socket> [coordinates] [margin] > <output>\n"
+            "        navit_binfile_extractor diff <old binfile> <new binfile> > <patch>\n"
+            "        navit_binfile_extractor apply <old binfile> < <patch> > <new binfile>\n"
+            "        navit_binfile_extractor merge <binfile> <binfile>... > <binfile>\n"
+            "\n"
+            " NavIT binfile extractor extracts given area from a NavIT binfile\n"
+            " It reads binfile from stdin and writes result to stdout. \n"
+            " If stdin is a regular file, only the kept tiles are read.\n"
+            "\n"
+            " Coordinates\n"
+            "  <bottom left lon> <bottom left lat> <top right lon> <top right lat>\n"
+            "\n"
+            " Options\n"
+            "  -f <jobs file>  extract many areas in one pass over the input. Each line\n"
+            "                  names an output file followed by its coordinates or\n"
+            "                  a polygon file.\n"
+            "  -i <index file> take the tile list from an index written by the index\n"
+            "                  command. Ignored if it doesn't match the input.\n"
+            "  -j <threads>    copy tile data with this many threads. Input and output\n"
+            "                  must be regular files.\n"
+            "  -c <margin>     clip tiles on the border of the area, dropping items\n"
+            "                  further away than margin (NavIT mercator units,\n"
+            "                  about meters).\n"
+            "  --outer=<lon>,<lat>,<lon>,<lat>\n"
+            "                  also keep the shallow tiles touching this larger box,\n"
+            "                  the ones with long roads, borders and large water\n"
+            "  --outer-depth=<depth>\n"
+            "                  deepest quadtree level kept in the outer box (%d)\n"
+            "  --checkpoint=<file>\n"
+            "                  save the state of the run there every 256 MB of tile\n"
+            "                  data, and resume from it if it is there. Input and\n"
+            "                  outputs must be regular files, write stdout with\n"
+            "                  1<> instead of > to keep what it has.\n"
+            "  --checkpoint-interval=<MB>\n"
+            "                  tile data read between checkpoints\n"
+            "  --recompress    deflate kept tiles again with the strongest zlib\n"
+            "                  settings, where that makes them smaller.\n"
+            "  --io=<backend>  how outputs are written: sync, thread (a writer thread\n"
+            "                  behind a pool of buffers) or uring (the same with\n"
+            "                  io_uring). auto, the default, writes asynchronously\n"
+            "                  when the input is a pipe and there is more than one\n"
+            "                  CPU.\n"
+            "  --compact       let all empty placeholders of tiles outside the area\n"
+            "                  share one local file header. Only their central\n"
+            "                  directory entries stay, NavIT finds tiles by number.\n"
+            "  --plan          write nothing, print the exact size of every output\n"
+            "                  and its kept and placeholder tiles per depth as a\n"
+            "                  JSON line on stdout. Only the headers of kept tiles\n"
+            "                  are read. With -c the size is an upper bound.\n"
+            "  --verify        check the CRC of every kept tile while copying, fails\n"
+            "                  the run if one doesn't match\n"
+            "  -v              name every kept tile\n"
+            "  --stats=json    print bytes read, skipped and written, tiles per depth,\n"
+            "                  time per phase and peak memory as one JSON line on\n"
+            "                  stderr when done. Timing costs about a microsecond\n"
+            "                  per tile.\n"
+            "  --stats-file=<file> write the JSON statistics there instead\n"
+            "  -p <polygon file> extract the area of an Osmosis .poly or GeoJSON\n"
+            "                  (multi)polygon instead of a rectangle.\n"
+            "\n"
+            " serve keeps the binfile mapped and indexed and answers requests on a Unix\n"
+            " socket, up to 4 or -j at once. A binfile renamed over <binfile> is served\n"
+            " from then on. request asks such a daemon for an extract.\n"
+            "\n"
+            " diff writes a patch with the tiles of the new binfile that are not in the\n"
+            " old one with the same crc and size. apply rebuilds the new binfile from\n"
+            " the old one and the patch.\n"
+            "\n"
+            " merge writes the union of extracts of the same map, taking every tile from\n"
+            " the binfile that has the most of it.\n"
+            "\n"
+            " Example: extract Munich, Bavaria from world map\n"
+            "  cat world.bin | navit_binfile_extractor 11.3 47.9 11.7 48.2 > munich.bin\n"
+            "  navit_binfile_extractor 11.3 47.9 11.7 48.2 < world.bin > munich.bin\n"
+            "\n", OUTER_DEPTH);
+}
+
+static int is_number(const char * value) {
+    char * endp;
+    strtod(value, &endp);
+    return (endp != value) && (*endp == 0);
+}
+
+static int parse_coordinates(char ** values, extractor_parameters_t *p) {
+    double * coordinates[4] = {&p->lon_bottom_left, &p->lat_bottom_left, &p->lon_top_right, &p->lat_top_right};
+    char * endp;
+    int i;
+    for(i = 0; i < 4; i ++) {
+        if(values[i] == NULL)
+            return -1;
+        *(coordinates[i]) = strtod(values[i], &endp);
+        if(endp != (values[i] + strlen(values[i])))
+            return -1;
+    }
+    /* same order as the filename from planet extractor */
+    getmercator(p->lon_bottom_left,p->lat_bottom_left,p->lon_top_right,p->lat_top_right, &p->area);
+    return 0;
+}
+
+/* <lon>,<lat>,<lon>,<lat> as one argument */
+static int parse_outer(char * argument, extractor_parameters_t *p) {
+    char * values[5];
+    char * save;
+    int i;
+    values[0] = strtok_r(argument, ",", &save);
+    for(i = 1; i < 5; i ++)
+        values[i] = strtok_r(NULL, ",", &save);
+    if(values[4] != NULL)
+        return -1;
+    return parse_coordinates(values, p);
+}
+
+static struct polygon_area * load_polygon(const char * path) {
+    struct polygon_area * polygon = malloc(sizeof(*polygon));
+    if(polygon_area_read(path, polygon) != 0) {
+        free(polygon);
+        return NULL;
+    }
+    return polygon;
+}
+
+static void free_polygon(struct polygon_area * polygon) {
+    if(polygon == NULL)
+        return;
+    polygon_area_free(polygon);
+    free(polygon);
+}
+
+static void close_jobs(extract_sink_t *sinks, int count) {
+    int i;
+    for(i = 0; i < count; i ++) {
+        fclose(sinks[i].outfile);
+        free(sinks[i].name);
+        free_polygon(sinks[i].polygon);
+    }
+    free(sinks);
+}
+
+/* a resumed run goes on writing the outputs of the interrupted one */
+static FILE * open_output(const char * path, int plan, int resumable) {
+    int fd;
+    FILE * file;
+    if(plan)
+        return fopen("/dev/null", "w");
+    if(!resumable)
+        return fopen(path, "w");
+    fd = open(path, O_WRONLY | O_CREAT, 0666);
+    if(fd < 0)
+        return NULL;
+    file = fdopen(fd, "w");
+    if(file == NULL)
+        close(fd);
+    return file;
+}
+
+/* one output per line: <output file> <bottom left lon> <bottom left lat> <top right lon> <top right lat>
+ * or <output file> <polygon file> */
+static int read_jobs(const char * jobs, extract_sink_t **sinks, int plan, int resumable) {
+    FILE * file;
+    char line[4096];
+    int count = 0;
+    int number = 0;
+    int error = 0;
+
+    *sinks = NULL;
+    file = fopen(jobs, "r");
+    if(file == NULL) {
+        fprintf(stderr, "ERROR opening %s: %s\n", jobs, strerror(errno));
+        return -1;
+    }
+    while(fgets(line, sizeof(line), file) != NULL) {
+        char * values[5];
+        char * save;
+        extractor_parameters_t p;
+        struct polygon_area * polygon = NULL;
+        int i;
+        number ++;
+        values[0] = strtok_r(line, " \t\r\n", &save);
+        if((values[0] == NULL) || (values[0][0] == '#'))
+            continue;
+        for(i = 1; i < 5; i ++)
+            values[i] = strtok_r(NULL, " \t\r\n", &save);
+        if((values[1] != NULL) && (values[2] == NULL)) {
+            polygon = load_polygon(values[1]);
+            if(polygon == NULL) {
+                fprintf(stderr, "ERROR %s:%d: can't use polygon %s\n", jobs, number, values[1]);
+                error = 1;
+                break;
+            }
+            p.area = polygon->bbox;
+        } else if((parse_coordinates(values +1, &p) != 0) || (strtok_r(NULL, " \t\r\n", &save) != NULL)) {
+            fprintf(stderr, "ERROR %s:%d: expected <output> <lon> <lat> <lon> <lat> or <output> <polygon>\n",
+                    jobs, number);
+            error = 1;
+            break;
+        }
+        *sinks = reallocarray(*sinks, count +1, sizeof(extract_sink_t));
+        memset(&((*sinks)[count]), 0, sizeof(extract_sink_t));
+        (*sinks)[count].name = strdup(values[0]);
+        (*sinks)[count].area = p.area;
+        (*sinks)[count].polygon = polygon;
+        (*sinks)[count].outfile = open_output(values[0], plan, resumable);
+        if((*sinks)[count].outfile == NULL) {
+            fprintf(stderr, "ERROR opening %s: %s\n", values[0], strerror(errno));
+            free((*sinks)[count].name);
+            free_polygon(polygon);
+            error = 1;
+            break;
+        }
+        count ++;
+    }
+    fclose(file);
+    if(error) {
+        close_jobs(*sinks, count);
+        *sinks = NULL;
+        return -1;
+    }
+    return count;
+}
+
+static void write_stats(run_statistics_t *stats, const char *path) {
+    FILE * file = stderr;
+    if(path != NULL) {
+        file = fopen(path, "w");
+        if(file == NULL) {
+            fprintf(stderr, "ERROR opening %s: %s\n", path, strerror(errno));
+            return;
+        }
+    }
+    stats_write_json(stats, file);
+    if(path != NULL)
+        fclose(file);
+}
+
+/* what an output would be, the run itself wrote to /dev/null */
+static void write_plan(extract_sink_t *sink, int exact) {
+    int depth;
+    int first = 1;
+    printf("{\"output\":\"%s\",\"bytes\":%ld,\"exact\":%s,\"tiles\":[", (sink->name != NULL) ? sink->name : "-",
+           sink->written, exact ? "true" : "false");
+    for(depth = 0; depth < STATS_DEPTHS; depth ++) {
+        if((sink->kept[depth] == 0) && (sink->placeholders[depth] == 0))
+            continue;
+        printf("%s{\"depth\":%d,\"kept\":%ld,\"placeholder\":%ld}", first ? "" : ",", depth, sink->kept[depth],
+               sink->placeholders[depth]);
+        first = 0;
+    }
+    printf("]}\n");
+}
+
+/* clipping and recompressing are skipped by a plan, the tiles are counted whole */
+static void plan_sinks(extract_sink_t *sinks, int count) {
+    int i;
+    for(i = 0; i < count; i ++) {
+        sinks[i].plan = 1;
+        sinks[i].margin = -1;
+        sinks[i].recompress = 0;
+    }
+}
+
+enum long_option {
+    OPTION_STATS = 256,
+    OPTION_STATS_FILE,
+    OPTION_IO,
+    OPTION_COMPACT,
+    OPTION_PLAN,
+    OPTION_VERIFY,
+    OPTION_RECOMPRESS,
+    OPTION_OUTER,
+    OPTION_OUTER_DEPTH,
+    OPTION_CHECKPOINT,
+    OPTION_CHECKPOINT_INTERVAL
+};
+
+static struct option long_options[] = {
+    {"stats", required_argument, NULL, OPTION_STATS},
+    {"stats-file", required_argument, NULL, OPTION_STATS_FILE},
+    {"io", required_argument, NULL, OPTION_IO},
+    {"compact", no_argument, NULL, OPTION_COMPACT},
+    {"plan", no_argument, NULL, OPTION_PLAN},
+    {"verify", no_argument, NULL, OPTION_VERIFY},
+    {"recompress", no_argument, NULL, OPTION_RECOMPRESS},
+    {"outer", required_argument, NULL, OPTION_OUTER},
+    {"outer-depth", required_argument, NULL, OPTION_OUTER_DEPTH},
+    {"checkpoint", required_argument, NULL, OPTION_CHECKPOINT},
+    {"checkpoint-interval", required_argument, NULL, OPTION_CHECKPOINT_INTERVAL},
+    {NULL, 0, NULL, 0}
+};
+
+int main (int argc, char ** argv) {
+    FILE * infile = stdin;
+    extractor_parameters_t p;
+    extract_sink_t * sinks;
+    const char * jobs = NULL;
+    const char * index_path = NULL;
+    const char * polygon_path = NULL;
+    struct polygon_area * polygon = NULL;
+    char * endp;
+    const char * stats_path = NULL;
+    run_statistics_t stats;
+    int stats_json = 0;
+    int io = PIPELINE_AUTO;
+    int verbose = 1;
+    int threads = 1;
+    int margin = -1;
+    int compact = 0;
+    int plan = 0;
+    int verify = 0;
+    int recompress = 0;
+    extractor_parameters_t outer = {0};
+    int have_outer = 0;
+    int outer_depth = 0;
+    const char * checkpoint_path = NULL;
+    long interval = CHECKPOINT_INTERVAL >> 20;
+    checkpoint_t checkpoint;
+    int count;
+    int ret;
+    int c;
+    int i;
+
+    fprintf(stderr, "NavIT binfile extractor\n"
+            "Created by Metalstrolch 2019\n"
+            "This is free software; see the source for copying conditions.  There is NO\n"
+            "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n");
+
+    if((argc > 1) && (strcmp(argv[1], "index") == 0)) {
+        if(argc != 2) {
+            usage();
+            exit(1);
+        }
+        return create_index(infile, stdout);
+    }
+    if((argc > 1) && (strcmp(argv[1], "serve") == 0)) {
+        int requests = 4;
+        optind = 2;
+        while((c = getopt(argc, argv, "i:j:")) != -1) {
+            switch(c) {
+            case 'i':
+                index_path = optarg;
+                break;
+            case 'j':
+                requests = strtol(optarg, &endp, 10);
+                if((*endp != 0) || (requests < 1)) {
+                    usage();
+                    exit(1);
+                }
+                break;
+            default:
+                usage();
+                exit(1);
+            }
+        }
+        if((argc - optind) != 2) {
+            usage();
+            exit(1);
+        }
+        /* clients going away show up as write errors */
+        signal(SIGPIPE, SIG_IGN);
+        return serve_binfile(argv[optind], argv[optind +1], index_path, requests);
+    }
+    if((argc > 1) && (strcmp(argv[1], "request") == 0)) {
+        if(((argc != 7) && (argc != 8)) || (parse_coordinates(argv + 3, &p) != 0)) {
+            usage();
+            exit(1);
+        }
+        return request_extract(argv[2], argv + 3, argc - 3, stdout);
+    }
+
+    if((argc > 1) && ((strcmp(argv[1], "diff") == 0) || (strcmp(argv[1], "apply") == 0))) {
+        FILE * oldfile;
+        FILE * newfile = stdin;
+        if(argc != ((argv[1][0] == 'd') ? 4 : 3)) {
+            usage();
+            exit(1);
+        }
+        oldfile = fopen(argv[2], "r");
+        if((oldfile == NULL) || ((argc == 4) && ((newfile = fopen(argv[3], "r")) == NULL))) {
+            fprintf(stderr, "ERROR opening %s: %s\n", (oldfile == NULL) ? argv[2] : argv[3], strerror(errno));
+            exit(1);
+        }
+        if(argc == 4)
+            ret = create_delta(oldfile, newfile, stdout);
+        else
+            ret = apply_delta(oldfile, stdin, stdout);
+        fclose(oldfile);
+        if(newfile != stdin)
+            fclose(newfile);
+        return ret;
+    }
+    if((argc > 1) && (strcmp(argv[1], "merge") == 0)) {
+        FILE ** infiles;
+        if(argc < 4) {
+            usage();
+            exit(1);
+        }
+        infiles = calloc(argc - 2, sizeof(FILE *));
+        for(i = 0; i < argc - 2; i ++) {
+            infiles[i] = fopen(argv[i +2], "r");
+            if(infiles[i] == NULL) {
+                fprintf(stderr, "ERROR opening %s: %s\n", argv[i +2], strerror(errno));
+                exit(1);
+            }
+        }
+        ret = merge_binfiles(infiles, argv +2, argc - 2, stdout);
+        for(i = 0; i < argc - 2; i ++)
+            fclose(infiles[i]);
+        free(infiles);
+        return ret;
+    }
+
+    /* negative coordinates look like options, options end at the first number */
+    while((optind >= argc || !is_number(argv[optind]))
+            && ((c = getopt_long(argc, argv, "+c:f:i:j:p:vh", long_options, NULL)) != -1)) {
+        switch(c) {
+        case OPTION_STATS:
+            if(strcmp(optarg, "json") != 0) {
+                usage();
+                exit(1);
+            }
+            stats_json = 1;
+            break;
+        case OPTION_IO:
+            io = pipeline_backend(optarg);
+            if(io < 0) {
+                usage();
+                exit(1);
+            }
+            break;
+        case OPTION_COMPACT:
+            compact = 1;
+            break;
+        case OPTION_PLAN:
+            plan = 1;
+            break;
+        case OPTION_VERIFY:
+            verify = 1;
+            break;
+        case OPTION_RECOMPRESS:
+            recompress = 1;
+            break;
+        case OPTION_OUTER:
+            if(parse_outer(optarg, &outer) != 0) {
+                usage();
+                exit(1);
+            }
+            if(outer_depth == 0)
+                outer_depth = OUTER_DEPTH;
+            have_outer = 1;
+            break;
+        case OPTION_CHECKPOINT:
+            checkpoint_path = optarg;
+            break;
+        case OPTION_CHECKPOINT_INTERVAL:
+            interval = strtol(optarg, &endp, 10);
+            if((*endp != 0) || (interval < 1)) {
+                usage();
+                exit(1);
+            }
+            break;
+        case OPTION_OUTER_DEPTH:
+            outer_depth = strtol(optarg, &endp, 10);
+            if((*endp != 0) || (outer_depth < 1)) {
+                usage();
+                exit(1);
+            }
+            break;
+        case OPTION_STATS_FILE:
+            stats_path = optarg;
+            stats_json = 1;
+            break;
+        case 'v':
+            verbose ++;
+            break;
+        case 'c':
+            margin = strtol(optarg, &endp, 10);
+            if((*endp != 0) || (margin < 0)) {
+                usage();
+                exit(1);
+            }
+            break;
+        case 'f':
+            jobs = optarg;
+            break;
+        case 'i':
+            index_path = optarg;
+            break;
+        case 'p':
+            polygon_path = optarg;
+            break;
+        case 'j':
+            threads = strtol(optarg, &endp, 10);
+            if((*endp != 0) || (threads < 1)) {
+                usage();
+                exit(1);
+            }
+            break;
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    /* without the outer box the depth would keep shallow tiles everywhere */
+    if((outer_depth > 0) && !have_outer) {
+        fprintf(stderr, "ERROR --outer-depth needs --outer\n");
+        exit(1);
+    }
+    if(checkpoint_path != NULL) {
+        if(plan) {
+            usage();
+            exit(1);
+        }
+        checkpoint_init(&checkpoint, checkpoint_path, (uint64_t)interval << 20);
+    }
+
+    if(jobs != NULL) {
+        if((optind != argc) || (polygon_path != NULL)) {
+            usage();
+            exit(1);
+        }
+        count = read_jobs(jobs, &sinks, plan, checkpoint_path != NULL);
+        if(count <= 0) {
+            if(count == 0)
+                fprintf(stderr, "ERROR no jobs in %s\n", jobs);
+            exit(1);
+        }
+        for(i = 0; i < count; i ++) {
+            sinks[i].margin = margin;
+            sinks[i].compact = compact;
+            sinks[i].recompress = recompress;
+            sinks[i].outer = outer.area;
+            sinks[i].outer_depth = outer_depth;
+        }
+        if(plan)
+            plan_sinks(sinks, count);
+        fprintf(stderr, "%s %d areas\n", plan ? "Plan" : "Extract", count);
+        stats_init(&stats, stats_json, verbose);
+        stats.verify = verify;
+        if(checkpoint_path != NULL)
+            ret = process_binfile_resumable (infile, sinks, count, index_path, threads, &checkpoint, &stats);
+        else
+            ret = process_binfile (infile, sinks, count, index_path, threads, plan ? PIPELINE_SYNC : io, &stats);
+        for(i = 0; plan && (ret == 0) && (i < count); i ++)
+            write_plan(&(sinks[i]), (margin < 0) && !recompress);
+        close_jobs(sinks, count);
+        if(stats_json)
+            write_stats(&stats, stats_path);
+        return ret;
+    }
+
+    if(polygon_path != NULL) {
+        if(optind != argc) {
+            usage();
+            exit(1);
+        }
+        polygon = load_polygon(polygon_path);
+        if(polygon == NULL)
+            exit(1);
+        p.area = polygon->bbox;
+        fprintf(stderr, "Extract polygon %s (%d rings)\n", polygon_path, polygon->count);
+    } else if(((argc - optind) != 4) || (parse_coordinates(argv + optind, &p) != 0)) {
+        usage();
+        exit(1);
+    } else
+        fprintf(stderr, "Extract area (lon %f, lat %f) - (lon %f, lat %f)\n",p.lon_bottom_left, p.lat_bottom_left,
+                p.lon_top_right, p.lat_top_right);
+    fprintf(stderr, "NavIT Mercator (%d, %d) - (%d, %d)\n", p.area.l.x, p.area.l.y, p.area.h.x, p.area.h.y);
+    sinks = calloc(1, sizeof(extract_sink_t));
+    sinks->outfile = stdout;
+    sinks->area = p.area;
+    sinks->polygon = polygon;
+    sinks->margin = margin;
+    sinks->compact = compact;
+    sinks->recompress = recompress;
+    sinks->outer = outer.area;
+    sinks->outer_depth = outer_depth;
+    if(plan) {
+        plan_sinks(sinks, 1);
+        sinks->outfile = fopen("/dev/null", "w");
+        if(sinks->outfile == NULL) {
+            fprintf(stderr, "ERROR opening /dev/null: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+    stats_init(&stats, stats_json, verbose);
+    stats.verify = verify;
+    if(checkpoint_path != NULL)
+        ret = process_binfile_resumable (infile, sinks, 1, index_path, threads, &checkpoint, &stats);
+    else
+        ret = process_binfile (infile, sinks, 1, index_path, threads, plan ? PIPELINE_SYNC : io, &stats);
+    if(plan) {
+        if(ret == 0)
+            write_plan(sinks, (margin < 0) && !recompress);
+        fclose(sinks->outfile);
+    }
+    free_polygon(polygon);
+    free(sinks);
+    if(stats_json)
+        write_stats(&stats, stats_path);
+    return ret;
+}
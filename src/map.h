@@ -38,8 +38,43 @@ struct rect {
     struct coord h;
 };
 
+/* rings of a (multi)polygon in NavIT mercator. A point is inside if it is in
+ * an outline of a polygon and in none of that polygon's holes. */
+struct polygon_ring {
+    struct coord *points;
+    int count;
+    int allocated;
+    int polygon;
+    int hole;
+};
+
+struct polygon_area {
+    struct rect bbox;
+    struct polygon_ring *rings;
+    int count;
+    int polygons;
+};
+
+/* tile_bbox() of one name after the other, the rects of the prefix they share are kept */
+#define TILE_WALK_DEPTH 32
+typedef struct tile_walk tile_walk_t;
+struct tile_walk {
+    char path[TILE_WALK_DEPTH];
+    struct rect rects[TILE_WALK_DEPTH +1]; /* rects[n] is the bbox of the first n characters of path */
+    int length;
+    int overlap;
+};
+
 void tile_bbox(char *tile, struct rect *r, int overlap);
+void tile_step(struct rect *r, char quadrant, int overlap);
+void tile_walk_init(tile_walk_t *walk, int overlap);
+void tile_walk_bbox(tile_walk_t *walk, char *tile, struct rect *r);
 int tile_len(char *tile);
 int itembin_bbox_intersects (struct rect * b1, struct rect * b2);
 void getmercator(double sx,double sy, double ex, double ey, struct rect * bbox);
+void getmercator_coord(double lon, double lat, struct coord * c);
+int polygon_area_read(const char *path, struct polygon_area *area);
+void polygon_area_free(struct polygon_area *area);
+int polygon_area_intersects(struct polygon_area *area, struct rect *r);
+int polygon_area_covers(struct polygon_area *area, struct rect *r);
 #endif
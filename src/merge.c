@@ -0,0 +1,212 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "merge.h"
+#include "zipfile.h"
+#include "input.h"
+
+typedef struct merge_input merge_input_t;
+struct merge_input {
+    binfile_input_t input;
+    central_directory_t directory; /* in directory order */
+};
+
+/* a tile as found in one of the inputs */
+typedef struct merge_tile merge_tile_t;
+struct merge_tile {
+    const char * name;
+    uint16_t name_length;
+    int input;          /* place in the directory: input and entry of the first copy */
+    uint64_t entry;
+    int source;         /* where the data is read from: input and entry of the chosen copy */
+    uint64_t source_entry;
+    uint64_t size;
+};
+
+static int compare_name(const merge_tile_t * a, const merge_tile_t * b) {
+    int order = memcmp(a->name, b->name, (a->name_length < b->name_length) ? a->name_length : b->name_length);
+    if(order != 0)
+        return order;
+    return (int)a->name_length - (int)b->name_length;
+}
+
+static int compare_position(const merge_tile_t * a, const merge_tile_t * b) {
+    if(a->input != b->input)
+        return a->input - b->input;
+    if(a->entry < b->entry)
+        return -1;
+    return (a->entry > b->entry);
+}
+
+/* copies of the same tile next to each other, the first one seen in front */
+static int compare_tile(const void * a, const void * b) {
+    int order = compare_name(a, b);
+    if(order != 0)
+        return order;
+    return compare_position(a, b);
+}
+
+static int compare_directory_position(const void * a, const void * b) {
+    return compare_position(a, b);
+}
+
+/* local header and data of tile, at offset of the output */
+static int64_t write_tile(merge_input_t * inputs, merge_tile_t * tile, uint64_t offset,
+                      local_file_header_storage_t * storage, FILE * outfile, copy_statistics_t * stats) {
+    merge_input_t * input = &(inputs[tile->source]);
+    central_directory_entry_t * entry = &(input->directory.entries[tile->source_entry]);
+    local_file_header_t * header;
+    local_file_header_t * stored;
+    uint64_t header_size;
+
+    if((input_seek(&(input->input), entry->offset) != 0)
+            || ((header = input_peek(&(input->input), sizeof(*header))) == NULL)
+            || (header->local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE))
+        return -1;
+    if((header = input_peek(&(input->input), sizeof(*header) + header->file_name_length
+                            + header->extra_field_length)) == NULL)
+        return -1;
+    /* the name from the directory, placeholders of compact binfiles share a local header */
+    header_size = sizeof(*header) + tile->name_length + header->extra_field_length;
+    stored = storage_add_header(storage, header_size);
+    memcpy(stored, header, sizeof(*header));
+    stored->file_name_length = tile->name_length;
+    memcpy(stored +1, tile->name, tile->name_length);
+    memcpy((char *)(stored +1) + tile->name_length, (char *)(header +1) + header->file_name_length,
+           header->extra_field_length);
+    patch_file_length(offset, stored, tile->size);
+    remember_local_file(storage, stored, offset);
+    if(fwrite(stored, header_size, 1, outfile) != 1)
+        return -1;
+    if((input_skip(&(input->input), sizeof(*header) + header->file_name_length + header->extra_field_length) != 0)
+            || (input_copy(&(input->input), tile->size, outfile, stats) != tile->size))
+        return -1;
+    return header_size + tile->size;
+}
+
+int merge_binfiles(FILE ** infiles, char ** names, int count, FILE * outfile) {
+    merge_input_t * inputs;
+    merge_tile_t * tiles = NULL;
+    local_file_header_storage_t storage;
+    copy_statistics_t stats;
+    uint64_t total = 0;
+    uint64_t merged = 0;
+    uint64_t with_data = 0;
+    uint64_t written = 0;
+    uint64_t directory_offset;
+    uint64_t directory_size;
+    uint64_t i;
+    uint64_t j;
+    int opened = 0;
+    int ret = 1;
+
+    memset(&storage, 0, sizeof(storage));
+    memset(&stats, 0, sizeof(stats));
+    inputs = calloc(count, sizeof(merge_input_t));
+    if(inputs == NULL)
+        return 1;
+    for(opened = 0; opened < count; opened ++) {
+        if((input_open(&(inputs[opened].input), infiles[opened]) != 0) || !inputs[opened].input.seekable) {
+            fprintf(stderr, "ERROR %s has to be a regular file\n", names[opened]);
+            input_close(&(inputs[opened].input));
+            goto done;
+        }
+        if(read_central_directory(&(inputs[opened].input), &(inputs[opened].directory)) != 0) {
+            fprintf(stderr, "ERROR no usable central directory in %s\n", names[opened]);
+            input_close(&(inputs[opened].input));
+            goto done;
+        }
+        total += inputs[opened].directory.count;
+    }
+
+    tiles = malloc((total +1) * sizeof(merge_tile_t));
+    if(tiles == NULL) {
+        fprintf(stderr, "ERROR out of memory\n");
+        goto done;
+    }
+    for(i = 0; i < (uint64_t)count; i ++) {
+        for(j = 0; j < inputs[i].directory.count; j ++) {
+            central_directory_entry_t * entry = &(inputs[i].directory.entries[j]);
+            merge_tile_t * tile = &(tiles[merged ++]);
+            tile->name = (const char *)(entry->header +1);
+            tile->name_length = entry->header->file_name_length;
+            tile->input = i;
+            tile->entry = j;
+            tile->source = i;
+            tile->source_entry = j;
+            tile->size = entry->compressed_size;
+        }
+    }
+    /* one tile per name: the largest copy, in the place of the first */
+    qsort(tiles, total, sizeof(merge_tile_t), compare_tile);
+    merged = 0;
+    for(i = 0; i < total; i = j) {
+        merge_tile_t * best = &(tiles[i]);
+        for(j = i +1; (j < total) && (compare_name(&(tiles[i]), &(tiles[j])) == 0); j ++) {
+            if(tiles[j].size > best->size)
+                best = &(tiles[j]);
+        }
+        tiles[i].source = best->source;
+        tiles[i].source_entry = best->source_entry;
+        tiles[i].size = best->size;
+        tiles[merged ++] = tiles[i];
+    }
+    qsort(tiles, merged, sizeof(merge_tile_t), compare_directory_position);
+
+    for(i = 0; i < merged; i ++) {
+        int64_t size = write_tile(inputs, &(tiles[i]), written, &storage, outfile, &stats);
+        if(size < 0) {
+            fprintf(stderr, "ERROR copying tile %.*s from %s: %s\n", tiles[i].name_length, tiles[i].name,
+                    names[tiles[i].source], strerror(errno));
+            goto done;
+        }
+        written += size;
+        if(tiles[i].size > 0)
+            with_data ++;
+    }
+    directory_offset = written;
+    directory_size = write_central_directory(&storage, outfile);
+    written += directory_size;
+    written += write_end_of_central_directory(written, directory_offset, directory_size, &storage, outfile);
+    if(fflush(outfile) != 0) {
+        fprintf(stderr, "ERROR writing: %s\n", strerror(errno));
+        goto done;
+    }
+    fprintf(stderr, "merged %ld tiles of %d binfiles into %ld, %ld of them with data, %ld bytes\n", total, count,
+            merged, with_data, written);
+    print_copy_statistics(&stats);
+    ret = 0;
+done:
+    free(tiles);
+    for(i = 0; i < (uint64_t)opened; i ++) {
+        free_central_directory(&(inputs[i].directory));
+        input_close(&(inputs[i].input));
+    }
+    free(inputs);
+    free_storage(&storage);
+    return ret;
+}
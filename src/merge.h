@@ -0,0 +1,31 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __merge_h
+#define __merge_h
+#include <stdio.h>
+
+/* Union of binfiles cut from the same map. A tile in several of them is taken
+ * from the one with the most data, so a real tile wins over the empty
+ * placeholder of an extract that didn't keep it and a whole border tile over a
+ * clipped one. The central directory keeps the order of the first binfile,
+ * tiles only in later ones follow in theirs. */
+int merge_binfiles(FILE ** infiles, char ** names, int count, FILE * outfile);
+#endif
@@ -0,0 +1,295 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "navitextract.h"
+#include "extractor.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "map.h"
+
+/* the callback streams buffer this much before calling back */
+#define NAVIT_EXTRACT_BUFFER (64*1024)
+
+struct navit_extract {
+    FILE * infile;
+    extract_sink_t * sinks;
+    int count;
+    char * index_path;
+    int threads;
+    int io;
+    int verbose;
+    int verify;
+    int ran;
+    run_statistics_t stats;
+};
+
+navit_extract_t * navit_extract_new(void) {
+    navit_extract_t * extract = calloc(1, sizeof(*extract));
+    if(extract == NULL)
+        return NULL;
+    extract->threads = 1;
+    extract->io = PIPELINE_AUTO;
+    stats_init(&(extract->stats), 0, 0);
+    return extract;
+}
+
+static void free_polygon(struct polygon_area * polygon) {
+    if(polygon == NULL)
+        return;
+    polygon_area_free(polygon);
+    free(polygon);
+}
+
+void navit_extract_free(navit_extract_t * extract) {
+    int i;
+    if(extract == NULL)
+        return;
+    if(extract->infile != NULL)
+        fclose(extract->infile);
+    for(i = 0; i < extract->count; i ++) {
+        fclose(extract->sinks[i].outfile);
+        free_polygon(extract->sinks[i].polygon);
+    }
+    free(extract->sinks);
+    free(extract->index_path);
+    free(extract);
+}
+
+static int set_input(navit_extract_t * extract, FILE * file) {
+    if(file == NULL) {
+        fprintf(stderr, "ERROR opening input: %s\n", strerror(errno));
+        return -1;
+    }
+    if(extract->infile != NULL)
+        fclose(extract->infile);
+    extract->infile = file;
+    return 0;
+}
+
+int navit_extract_set_input_fd(navit_extract_t * extract, int fd) {
+    int copy = dup(fd);
+    FILE * file;
+    if(copy < 0)
+        return set_input(extract, NULL);
+    file = fdopen(copy, "r");
+    if(file == NULL)
+        close(copy);
+    return set_input(extract, file);
+}
+
+int navit_extract_set_input_reader(navit_extract_t * extract, navit_extract_read_t read, void * context) {
+    cookie_io_functions_t functions = {read, NULL, NULL, NULL};
+    FILE * file = fopencookie(context, "r", functions);
+    if(file != NULL)
+        setvbuf(file, NULL, _IOFBF, NAVIT_EXTRACT_BUFFER);
+    return set_input(extract, file);
+}
+
+static int add_output(navit_extract_t * extract, FILE * file) {
+    extract_sink_t * sinks;
+    extract_sink_t * sink;
+    if(file == NULL) {
+        fprintf(stderr, "ERROR opening output: %s\n", strerror(errno));
+        return -1;
+    }
+    sinks = reallocarray(extract->sinks, extract->count +1, sizeof(extract_sink_t));
+    if(sinks == NULL) {
+        fclose(file);
+        return -1;
+    }
+    extract->sinks = sinks;
+    sink = &(sinks[extract->count]);
+    memset(sink, 0, sizeof(*sink));
+    sink->outfile = file;
+    sink->margin = -1;
+    sink->area.l.x = WORLD_BOUNDINGBOX_MIN_X;
+    sink->area.l.y = WORLD_BOUNDINGBOX_MIN_Y;
+    sink->area.h.x = WORLD_BOUNDINGBOX_MAX_X;
+    sink->area.h.y = WORLD_BOUNDINGBOX_MAX_Y;
+    return extract->count ++;
+}
+
+int navit_extract_add_output_fd(navit_extract_t * extract, int fd) {
+    int copy = dup(fd);
+    FILE * file;
+    if(copy < 0)
+        return add_output(extract, NULL);
+    file = fdopen(copy, "w");
+    if(file == NULL)
+        close(copy);
+    return add_output(extract, file);
+}
+
+int navit_extract_add_output_writer(navit_extract_t * extract, navit_extract_write_t write, void * context) {
+    cookie_io_functions_t functions = {NULL, write, NULL, NULL};
+    FILE * file = fopencookie(context, "w", functions);
+    if(file != NULL)
+        setvbuf(file, NULL, _IOFBF, NAVIT_EXTRACT_BUFFER);
+    return add_output(extract, file);
+}
+
+static extract_sink_t * get_sink(navit_extract_t * extract, int output) {
+    if((output < 0) || (output >= extract->count)) {
+        fprintf(stderr, "ERROR no output %d\n", output);
+        return NULL;
+    }
+    return &(extract->sinks[output]);
+}
+
+int navit_extract_set_bbox(navit_extract_t * extract, int output,
+                           double lon_bottom_left, double lat_bottom_left,
+                           double lon_top_right, double lat_top_right) {
+    extract_sink_t * sink = get_sink(extract, output);
+    if(sink == NULL)
+        return -1;
+    free_polygon(sink->polygon);
+    sink->polygon = NULL;
+    getmercator(lon_bottom_left, lat_bottom_left, lon_top_right, lat_top_right, &(sink->area));
+    return 0;
+}
+
+int navit_extract_set_polygon(navit_extract_t * extract, int output, const char * path) {
+    extract_sink_t * sink = get_sink(extract, output);
+    struct polygon_area * polygon;
+    if(sink == NULL)
+        return -1;
+    polygon = malloc(sizeof(*polygon));
+    if((polygon == NULL) || (polygon_area_read(path, polygon) != 0)) {
+        fprintf(stderr, "ERROR can't use polygon %s\n", path);
+        free(polygon);
+        return -1;
+    }
+    free_polygon(sink->polygon);
+    sink->polygon = polygon;
+    sink->area = polygon->bbox;
+    return 0;
+}
+
+int navit_extract_set_outer(navit_extract_t * extract, int output,
+                            double lon_bottom_left, double lat_bottom_left,
+                            double lon_top_right, double lat_top_right, int depth) {
+    extract_sink_t * sink = get_sink(extract, output);
+    if(sink == NULL)
+        return -1;
+    getmercator(lon_bottom_left, lat_bottom_left, lon_top_right, lat_top_right, &(sink->outer));
+    sink->outer_depth = (depth < 0) ? 0 : depth;
+    return 0;
+}
+
+int navit_extract_set_clip(navit_extract_t * extract, int output, int margin) {
+    extract_sink_t * sink = get_sink(extract, output);
+    if(sink == NULL)
+        return -1;
+    sink->margin = (margin < 0) ? -1 : margin;
+    return 0;
+}
+
+int navit_extract_set_compact(navit_extract_t * extract, int output, int compact) {
+    extract_sink_t * sink = get_sink(extract, output);
+    if(sink == NULL)
+        return -1;
+    sink->compact = (compact != 0);
+    return 0;
+}
+
+int navit_extract_set_recompress(navit_extract_t * extract, int output, int recompress) {
+    extract_sink_t * sink = get_sink(extract, output);
+    if(sink == NULL)
+        return -1;
+    sink->recompress = (recompress != 0);
+    return 0;
+}
+
+int navit_extract_set_index(navit_extract_t * extract, const char * path) {
+    free(extract->index_path);
+    extract->index_path = (path != NULL) ? strdup(path) : NULL;
+    return 0;
+}
+
+int navit_extract_set_threads(navit_extract_t * extract, int threads) {
+    extract->threads = (threads < 1) ? 1 : threads;
+    return 0;
+}
+
+int navit_extract_set_io(navit_extract_t * extract, const char * backend) {
+    int io = pipeline_backend(backend);
+    if(io < 0) {
+        fprintf(stderr, "ERROR unknown io backend %s\n", backend);
+        return -1;
+    }
+    extract->io = io;
+    return 0;
+}
+
+int navit_extract_set_verbose(navit_extract_t * extract, int verbose) {
+    extract->verbose = verbose;
+    return 0;
+}
+
+int navit_extract_set_verify(navit_extract_t * extract, int verify) {
+    extract->verify = (verify != 0);
+    return 0;
+}
+
+int navit_extract_run(navit_extract_t * extract) {
+    int ret;
+    int i;
+
+    if(extract->ran || (extract->infile == NULL) || (extract->count == 0)) {
+        fprintf(stderr, "ERROR %s\n", extract->ran ? "extraction already ran" : "need an input and an output");
+        return -1;
+    }
+    extract->ran = 1;
+    stats_init(&(extract->stats), 0, extract->verbose);
+    extract->stats.verify = extract->verify;
+    ret = process_binfile(extract->infile, extract->sinks, extract->count, extract->index_path, extract->threads,
+                          extract->io, &(extract->stats));
+    for(i = 0; i < extract->count; i ++) {
+        if(fflush(extract->sinks[i].outfile) != 0) {
+            fprintf(stderr, "ERROR writing output %d: %s\n", i, strerror(errno));
+            ret = 1;
+        }
+    }
+    return (ret == 0) ? 0 : -1;
+}
+
+int navit_extract_get_stats(navit_extract_t * extract, navit_extract_stats_t * stats) {
+    run_statistics_t * run = &(extract->stats);
+    int depth;
+    memset(stats, 0, sizeof(*stats));
+    stats->bytes_read = run->bytes_read;
+    stats->bytes_skipped = run->bytes_skipped;
+    stats->bytes_written = run->bytes_written;
+    for(depth = 0; depth < STATS_DEPTHS; depth ++) {
+        stats->tiles_kept += run->kept[depth];
+        stats->tiles_placeholder += run->placeholders[depth];
+        stats->tiles_dropped += run->dropped[depth];
+    }
+    return 0;
+}
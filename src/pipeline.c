@@ -0,0 +1,450 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "pipeline.h"
+
+static const char * backend_names[PIPELINE_BACKEND_COUNT] = {"auto", "sync", "thread", "uring"};
+
+int pipeline_backend(const char * name) {
+    int i;
+    for(i = 0; i < PIPELINE_BACKEND_COUNT; i ++)
+        if(strcmp(name, backend_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+const char * pipeline_backend_name(int backend) {
+    return backend_names[backend];
+}
+
+/* write out what is left of the buffer, returns 0 or an errno value */
+static int write_buffer(pipeline_buffer_t * buffer) {
+    while(buffer->done < buffer->size) {
+        ssize_t put;
+        if(buffer->offset >= 0)
+            put = pwrite(buffer->stream->fd, buffer->data + buffer->done, buffer->size - buffer->done,
+                         buffer->offset + buffer->done);
+        else
+            put = write(buffer->stream->fd, buffer->data + buffer->done, buffer->size - buffer->done);
+        if((put < 0) && (errno == EINTR))
+            continue;
+        if(put <= 0)
+            return (put < 0) ? errno : EIO;
+        buffer->done += put;
+    }
+    return 0;
+}
+
+/* the lock is held by the caller in all of the following */
+static void release_buffer(pipeline_t * pipeline, pipeline_buffer_t * buffer, int error) {
+    if((error != 0) && (buffer->stream->error == 0))
+        buffer->stream->error = error;
+    buffer->stream->pending --;
+    pipeline->pending --;
+    buffer->next = pipeline->free;
+    pipeline->free = buffer;
+    pthread_cond_broadcast(&(pipeline->done));
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+static int uring_setup(pipeline_t * pipeline) {
+    struct io_uring_params params;
+    char * sq;
+    char * cq;
+
+    memset(&params, 0, sizeof(params));
+    pipeline->ring = syscall(__NR_io_uring_setup, PIPELINE_BUFFERS, &params);
+    if(pipeline->ring < 0)
+        return -1;
+    /* writes at the current position of pipes came with the same kernel as IORING_OP_WRITE */
+    if(!(params.features & IORING_FEAT_RW_CUR_POS))
+        return -1;
+    pipeline->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    pipeline->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(pipeline->cq_map_size > pipeline->sq_map_size)
+            pipeline->sq_map_size = pipeline->cq_map_size;
+        pipeline->cq_map_size = 0;
+    }
+    pipeline->sq_map = mmap(NULL, pipeline->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            pipeline->ring, IORING_OFF_SQ_RING);
+    if(pipeline->sq_map == MAP_FAILED) {
+        pipeline->sq_map = NULL;
+        return -1;
+    }
+    if(pipeline->cq_map_size > 0) {
+        pipeline->cq_map = mmap(NULL, pipeline->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                pipeline->ring, IORING_OFF_CQ_RING);
+        if(pipeline->cq_map == MAP_FAILED) {
+            pipeline->cq_map = NULL;
+            return -1;
+        }
+    }
+    pipeline->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    pipeline->sqes = mmap(NULL, pipeline->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          pipeline->ring, IORING_OFF_SQES);
+    if(pipeline->sqes == MAP_FAILED) {
+        pipeline->sqes = NULL;
+        return -1;
+    }
+    sq = pipeline->sq_map;
+    cq = (pipeline->cq_map != NULL) ? pipeline->cq_map : pipeline->sq_map;
+    pipeline->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    pipeline->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    pipeline->sq_array = (unsigned *)(sq + params.sq_off.array);
+    pipeline->cq_head = (unsigned *)(cq + params.cq_off.head);
+    pipeline->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    pipeline->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    pipeline->cqes = cq + params.cq_off.cqes;
+    return 0;
+}
+
+/* there are never more writes in flight than buffers, so the queue can't overflow */
+static void uring_submit(pipeline_t * pipeline, pipeline_buffer_t * buffer) {
+    unsigned tail = *(pipeline->sq_tail);
+    unsigned index = tail & *(pipeline->sq_mask);
+    struct io_uring_sqe * sqe = &(((struct io_uring_sqe *)pipeline->sqes)[index]);
+    int error;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = buffer->stream->fd;
+    sqe->addr = (uintptr_t)(buffer->data + buffer->done);
+    sqe->len = buffer->size - buffer->done;
+    sqe->off = (buffer->offset >= 0) ? (uint64_t)buffer->offset + buffer->done : (uint64_t)-1;
+    sqe->user_data = (uintptr_t)buffer;
+    pipeline->sq_array[index] = index;
+    __atomic_store_n(pipeline->sq_tail, tail +1, __ATOMIC_RELEASE);
+    while(syscall(__NR_io_uring_enter, pipeline->ring, 1, 0, 0, NULL, 0) < 0) {
+        if(errno == EINTR)
+            continue;
+        /* the kernel didn't take it, write it ourselves */
+        __atomic_store_n(pipeline->sq_tail, tail, __ATOMIC_RELEASE);
+        error = write_buffer(buffer);
+        release_buffer(pipeline, buffer, error);
+        return;
+    }
+}
+
+static void uring_reap(pipeline_t * pipeline, int wait) {
+    unsigned head = *(pipeline->cq_head);
+    unsigned tail = __atomic_load_n(pipeline->cq_tail, __ATOMIC_ACQUIRE);
+
+    if((head == tail) && wait) {
+        syscall(__NR_io_uring_enter, pipeline->ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        tail = __atomic_load_n(pipeline->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    while(head != tail) {
+        struct io_uring_cqe * cqe = &(((struct io_uring_cqe *)pipeline->cqes)[head & *(pipeline->cq_mask)]);
+        pipeline_buffer_t * buffer = (pipeline_buffer_t *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        head ++;
+        __atomic_store_n(pipeline->cq_head, head, __ATOMIC_RELEASE);
+        if((res == -EINTR) || (res == -EAGAIN)) {
+            uring_submit(pipeline, buffer);
+        } else if(res <= 0) {
+            release_buffer(pipeline, buffer, (res < 0) ? -res : EIO);
+        } else {
+            /* short writes carry on where they stopped */
+            buffer->done += res;
+            if(buffer->done < buffer->size)
+                uring_submit(pipeline, buffer);
+            else
+                release_buffer(pipeline, buffer, 0);
+        }
+    }
+}
+#endif
+
+static void uring_teardown(pipeline_t * pipeline) {
+    if(pipeline->sqes != NULL)
+        munmap(pipeline->sqes, pipeline->sqes_size);
+    if(pipeline->cq_map != NULL)
+        munmap(pipeline->cq_map, pipeline->cq_map_size);
+    if(pipeline->sq_map != NULL)
+        munmap(pipeline->sq_map, pipeline->sq_map_size);
+    if(pipeline->ring >= 0)
+        close(pipeline->ring);
+    pipeline->ring = -1;
+}
+
+static void * pipeline_writer(void * data) {
+    pipeline_t * pipeline = data;
+    pthread_mutex_lock(&(pipeline->lock));
+    for(;;) {
+        pipeline_buffer_t * buffer;
+        int error;
+        while((pipeline->first == NULL) && !pipeline->stop)
+            pthread_cond_wait(&(pipeline->work), &(pipeline->lock));
+        if(pipeline->first == NULL)
+            break;
+        buffer = pipeline->first;
+        pipeline->first = buffer->next;
+        if(pipeline->first == NULL)
+            pipeline->last = NULL;
+        pthread_mutex_unlock(&(pipeline->lock));
+        error = write_buffer(buffer);
+        pthread_mutex_lock(&(pipeline->lock));
+        release_buffer(pipeline, buffer, error);
+    }
+    pthread_mutex_unlock(&(pipeline->lock));
+    return NULL;
+}
+
+/* wait for a write to finish */
+static void pipeline_wait(pipeline_t * pipeline) {
+#ifdef HAVE_LINUX_IO_URING_H
+    if(pipeline->backend == PIPELINE_URING) {
+        uring_reap(pipeline, 1);
+        return;
+    }
+#endif
+    pthread_cond_wait(&(pipeline->done), &(pipeline->lock));
+}
+
+static void pipeline_queue(pipeline_t * pipeline, pipeline_buffer_t * buffer) {
+    pipeline_stream_t * stream = buffer->stream;
+    buffer->offset = stream->offset;
+    buffer->done = 0;
+    if(stream->offset >= 0)
+        stream->offset += buffer->size;
+#ifdef HAVE_LINUX_IO_URING_H
+    if(pipeline->backend == PIPELINE_URING) {
+        /* writes at the current position must not overtake each other */
+        while((stream->offset < 0) && (stream->pending > 0))
+            pipeline_wait(pipeline);
+        stream->pending ++;
+        pipeline->pending ++;
+        uring_submit(pipeline, buffer);
+        return;
+    }
+#endif
+    /* the writer thread keeps the order */
+    buffer->next = NULL;
+    if(pipeline->last != NULL)
+        pipeline->last->next = buffer;
+    else
+        pipeline->first = buffer;
+    pipeline->last = buffer;
+    stream->pending ++;
+    pipeline->pending ++;
+    pthread_cond_signal(&(pipeline->work));
+}
+
+static pipeline_buffer_t * take_buffer(pipeline_t * pipeline) {
+    pipeline_buffer_t * buffer;
+    int i;
+    for(;;) {
+        while((pipeline->free == NULL) && (pipeline->pending > 0))
+            pipeline_wait(pipeline);
+        buffer = pipeline->free;
+        if(buffer != NULL) {
+            pipeline->free = buffer->next;
+            buffer->size = 0;
+            return buffer;
+        }
+        /* every buffer is being filled by some stream, send one off half full */
+        for(i = 0; i < pipeline->count; i ++) {
+            pipeline_stream_t * stream = pipeline->streams[i];
+            if((stream->current != NULL) && (stream->current->size > 0)) {
+                pipeline_queue(pipeline, stream->current);
+                stream->current = NULL;
+                break;
+            }
+        }
+    }
+}
+
+static ssize_t stream_write(void * cookie, const char * data, size_t size) {
+    pipeline_stream_t * stream = cookie;
+    pipeline_t * pipeline = stream->pipeline;
+    size_t written = 0;
+
+    if(stream->error != 0) {
+        errno = stream->error;
+        return -1;
+    }
+    while(written < size) {
+        pipeline_buffer_t * buffer = stream->current;
+        uint64_t chunk;
+        if(buffer == NULL) {
+            pthread_mutex_lock(&(pipeline->lock));
+            buffer = take_buffer(pipeline);
+            pthread_mutex_unlock(&(pipeline->lock));
+            buffer->stream = stream;
+            stream->current = buffer;
+        }
+        chunk = PIPELINE_BUFFER_SIZE - buffer->size;
+        if(chunk > size - written)
+            chunk = size - written;
+        memcpy(buffer->data + buffer->size, data + written, chunk);
+        buffer->size += chunk;
+        written += chunk;
+        if(buffer->size == PIPELINE_BUFFER_SIZE) {
+            pthread_mutex_lock(&(pipeline->lock));
+            pipeline_queue(pipeline, buffer);
+            pthread_mutex_unlock(&(pipeline->lock));
+            stream->current = NULL;
+        }
+    }
+    return written;
+}
+
+static int stream_close(void * cookie) {
+    pipeline_stream_t * stream = cookie;
+    pipeline_t * pipeline = stream->pipeline;
+    int error;
+    int i;
+
+    pthread_mutex_lock(&(pipeline->lock));
+    if(stream->current != NULL) {
+        if(stream->current->size > 0)
+            pipeline_queue(pipeline, stream->current);
+        else {
+            stream->current->next = pipeline->free;
+            pipeline->free = stream->current;
+        }
+        stream->current = NULL;
+    }
+    while(stream->pending > 0)
+        pipeline_wait(pipeline);
+    for(i = 0; i < pipeline->count; i ++) {
+        if(pipeline->streams[i] == stream) {
+            pipeline->streams[i] = pipeline->streams[-- pipeline->count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(pipeline->lock));
+    /* leave the descriptor where stdio would have left it */
+    if(stream->offset >= 0)
+        lseek(stream->fd, stream->offset, SEEK_SET);
+    error = stream->error;
+    free(stream);
+    if(error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+/* falls back to the writer thread if the kernel has no io_uring, -1 if there is no way to write asynchronously */
+int pipeline_start(pipeline_t * pipeline, int backend) {
+    int i;
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->ring = -1;
+    pipeline->backend = backend;
+#ifdef HAVE_LINUX_IO_URING_H
+    if((backend == PIPELINE_URING) && (uring_setup(pipeline) != 0)) {
+        uring_teardown(pipeline);
+        pipeline->backend = PIPELINE_THREAD;
+    }
+#else
+    if(backend == PIPELINE_URING)
+        pipeline->backend = PIPELINE_THREAD;
+#endif
+    pthread_mutex_init(&(pipeline->lock), NULL);
+    pthread_cond_init(&(pipeline->done), NULL);
+    pthread_cond_init(&(pipeline->work), NULL);
+    if((pipeline->backend == PIPELINE_THREAD)
+            && (pthread_create(&(pipeline->thread), NULL, pipeline_writer, pipeline) != 0)) {
+        pipeline->backend = PIPELINE_SYNC;
+        pipeline_stop(pipeline);
+        return -1;
+    }
+    /* aligned, so they could go to O_DIRECT descriptors */
+    for(i = 0; i < PIPELINE_BUFFERS; i ++) {
+        pipeline_buffer_t * buffer = &(pipeline->buffers[i]);
+        if(posix_memalign((void **)&(buffer->data), 4096, PIPELINE_BUFFER_SIZE) != 0) {
+            pipeline_stop(pipeline);
+            return -1;
+        }
+        buffer->next = pipeline->free;
+        pipeline->free = buffer;
+    }
+    return 0;
+}
+
+/* a stdio stream writing to fd through the pipeline, fclose() it before stopping the pipeline */
+FILE * pipeline_open(pipeline_t * pipeline, int fd) {
+    cookie_io_functions_t functions = {NULL, stream_write, NULL, stream_close};
+    pipeline_stream_t * stream;
+    struct stat st;
+    FILE * file;
+
+    stream = calloc(1, sizeof(*stream));
+    stream->pipeline = pipeline;
+    stream->fd = fd;
+    stream->offset = -1;
+    /* positioned writes can be in flight together, appends and pipes have to queue */
+    if((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && !(fcntl(fd, F_GETFL) & O_APPEND))
+        stream->offset = lseek(fd, 0, SEEK_CUR);
+    file = fopencookie(stream, "w", functions);
+    if(file == NULL) {
+        free(stream);
+        return NULL;
+    }
+    /* the pipeline buffers are the stdio buffer */
+    setvbuf(file, NULL, _IONBF, 0);
+    pthread_mutex_lock(&(pipeline->lock));
+    pipeline->streams = reallocarray(pipeline->streams, pipeline->count +1, sizeof(pipeline_stream_t *));
+    pipeline->streams[pipeline->count ++] = stream;
+    pthread_mutex_unlock(&(pipeline->lock));
+    return file;
+}
+
+void pipeline_stop(pipeline_t * pipeline) {
+    int i;
+    if(pipeline->backend == PIPELINE_THREAD) {
+        pthread_mutex_lock(&(pipeline->lock));
+        pipeline->stop = 1;
+        pthread_cond_signal(&(pipeline->work));
+        pthread_mutex_unlock(&(pipeline->lock));
+        pthread_join(pipeline->thread, NULL);
+    }
+    uring_teardown(pipeline);
+    for(i = 0; i < PIPELINE_BUFFERS; i ++)
+        if(pipeline->buffers[i].data != NULL)
+            free(pipeline->buffers[i].data);
+    if(pipeline->streams != NULL)
+        free(pipeline->streams);
+    pthread_mutex_destroy(&(pipeline->lock));
+    pthread_cond_destroy(&(pipeline->done));
+    pthread_cond_destroy(&(pipeline->work));
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->ring = -1;
+}
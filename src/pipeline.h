@@ -0,0 +1,100 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __pipeline_h
+#define __pipeline_h
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Write behind for the outputs. Everything written to a pipeline stream is
+ * gathered in a small pool of page aligned buffers, full buffers are written
+ * by io_uring or a writer thread while the caller reads the next data. */
+#define PIPELINE_BUFFERS 8
+#define PIPELINE_BUFFER_SIZE (1024*1024)
+
+enum pipeline_backend {
+    PIPELINE_AUTO,      /* io_uring for streamed input on more than one CPU, sync otherwise */
+    PIPELINE_SYNC,      /* plain stdio and kernel copies */
+    PIPELINE_THREAD,
+    PIPELINE_URING,
+    PIPELINE_BACKEND_COUNT
+};
+
+typedef struct pipeline pipeline_t;
+typedef struct pipeline_stream pipeline_stream_t;
+
+typedef struct pipeline_buffer pipeline_buffer_t;
+struct pipeline_buffer {
+    pipeline_buffer_t * next;   /* free list or write queue */
+    pipeline_stream_t * stream;
+    char * data;
+    uint64_t size;              /* filled */
+    uint64_t done;              /* written */
+    int64_t offset;             /* in the output, -1 to write at the current position */
+};
+
+struct pipeline_stream {
+    pipeline_t * pipeline;
+    int fd;
+    int64_t offset;             /* where the next buffer goes, -1 for pipes and appending files */
+    pipeline_buffer_t * current;
+    int pending;                /* buffers queued or in flight */
+    int error;
+};
+
+struct pipeline {
+    int backend;
+    pipeline_buffer_t buffers[PIPELINE_BUFFERS];
+    pipeline_buffer_t * free;
+    int pending;
+    pipeline_stream_t ** streams;
+    int count;
+    /* writer thread */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    pthread_cond_t work;
+    pipeline_buffer_t * first;
+    pipeline_buffer_t * last;
+    int stop;
+    /* io_uring, set up with the raw system calls */
+    int ring;
+    unsigned * sq_tail;
+    unsigned * sq_mask;
+    unsigned * sq_array;
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    unsigned * cq_mask;
+    void * sqes;
+    void * cqes;
+    void * sq_map;
+    void * cq_map;
+    uint64_t sq_map_size;
+    uint64_t cq_map_size;
+    uint64_t sqes_size;
+};
+
+int pipeline_backend(const char * name);
+const char * pipeline_backend_name(int backend);
+int pipeline_start(pipeline_t * pipeline, int backend);
+FILE * pipeline_open(pipeline_t * pipeline, int fd);
+void pipeline_stop(pipeline_t * pipeline);
+#endif
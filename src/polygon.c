@@ -0,0 +1,426 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "map.h"
+
+static struct polygon_ring * add_ring(struct polygon_area *area, int polygon, int hole) {
+    struct polygon_ring * ring;
+    area->rings = reallocarray(area->rings, area->count +1, sizeof(*ring));
+    ring = &(area->rings[area->count ++]);
+    memset(ring, 0, sizeof(*ring));
+    ring->polygon = polygon;
+    ring->hole = hole;
+    if(polygon >= area->polygons)
+        area->polygons = polygon +1;
+    return ring;
+}
+
+static void add_point(struct polygon_area *area, struct polygon_ring *ring, double lon, double lat) {
+    struct coord c;
+    getmercator_coord(lon, lat, &c);
+    if(ring->count == ring->allocated) {
+        ring->allocated = (ring->allocated == 0) ? 64 : ring->allocated * 2;
+        ring->points = reallocarray(ring->points, ring->allocated, sizeof(struct coord));
+    }
+    ring->points[ring->count ++] = c;
+    if((area->count == 1) && (ring->count == 1)) {
+        area->bbox.l = c;
+        area->bbox.h = c;
+    }
+    if(c.x < area->bbox.l.x)
+        area->bbox.l.x = c.x;
+    if(c.y < area->bbox.l.y)
+        area->bbox.l.y = c.y;
+    if(c.x > area->bbox.h.x)
+        area->bbox.h.x = c.x;
+    if(c.y > area->bbox.h.y)
+        area->bbox.h.y = c.y;
+}
+
+/* Osmosis polygon filter file: a name line, then sections of "lon lat" lines
+ * each closed by END, then END. Every section is an outline of a polygon of
+ * its own, unless its name starts with !, then it is a hole of the outline
+ * before it. */
+static int read_poly(FILE *file, struct polygon_area *area) {
+    char line[1024];
+    struct polygon_ring * ring = NULL;
+    int number = 0;
+
+    while(fgets(line, sizeof(line), file) != NULL) {
+        char * text = line;
+        double lon;
+        double lat;
+        number ++;
+        while(isspace((unsigned char)*text))
+            text ++;
+        if(number == 1)
+            continue; /* name of the polygon */
+        if(*text == 0)
+            continue;
+        if(ring == NULL) {
+            if(strncmp(text, "END", 3) == 0)
+                return (area->count > 0) ? 0 : -1;
+            if(*text != '!')
+                ring = add_ring(area, area->polygons, 0);
+            else if(area->polygons > 0)
+                ring = add_ring(area, area->polygons -1, 1);
+            else {
+                fprintf(stderr, "ERROR polygon line %d: hole before any outline\n", number);
+                return -1;
+            }
+            continue;
+        }
+        if(strncmp(text, "END", 3) == 0) {
+            if(ring->count < 3)
+                return -1;
+            ring = NULL;
+            continue;
+        }
+        if(sscanf(text, "%lf %lf", &lon, &lat) != 2) {
+            fprintf(stderr, "ERROR polygon line %d: expected <lon> <lat>\n", number);
+            return -1;
+        }
+        add_point(area, ring, lon, lat);
+    }
+    fprintf(stderr, "ERROR polygon file ends without END\n");
+    return -1;
+}
+
+static const char * skip_space(const char * text) {
+    while(isspace((unsigned char)*text))
+        text ++;
+    return text;
+}
+
+/* nested coordinate arrays of a GeoJSON geometry. Arrays of numbers are
+ * positions, arrays of positions are rings. The first ring of a polygon is
+ * its outline, the others are holes. */
+static const char * read_geojson_array(const char * text, struct polygon_area *area, int *polygon) {
+    int first_ring = 1;
+    text = skip_space(text);
+    if(*text != '[')
+        return NULL;
+    text = skip_space(text +1);
+    if((*text == '[') && (*skip_space(text +1) != '[')) {
+        /* array of positions: a ring */
+        struct polygon_ring * ring = add_ring(area, *polygon, 0);
+        while(*text == '[') {
+            char * end;
+            double lon = strtod(text +1, &end);
+            double lat;
+            text = skip_space(end);
+            if(*text != ',')
+                return NULL;
+            lat = strtod(text +1, &end);
+            text = end;
+            /* ignore altitude */
+            while((*text != ']') && (*text != 0))
+                text ++;
+            if(*text != ']')
+                return NULL;
+            add_point(area, ring, lon, lat);
+            text = skip_space(text +1);
+            if(*text == ',')
+                text = skip_space(text +1);
+        }
+        if(ring->count < 3)
+            return NULL;
+        return (*text == ']') ? text +1 : NULL;
+    }
+    /* array of arrays: a polygon if its elements are rings, a multipolygon otherwise */
+    while(*text == '[') {
+        const char * inner = skip_space(text +1);
+        int rings = (*inner == '[') && (*skip_space(inner +1) == '[');
+        uint64_t before = area->count;
+        text = read_geojson_array(text, area, polygon);
+        if(text == NULL)
+            return NULL;
+        if(!rings) {
+            /* that was a ring of this polygon */
+            if(!first_ring)
+                area->rings[before].hole = 1;
+            first_ring = 0;
+        }
+        text = skip_space(text);
+        if(*text == ',')
+            text = skip_space(text +1);
+    }
+    if(!first_ring)
+        (*polygon) ++;
+    return (*text == ']') ? text +1 : NULL;
+}
+
+/* a JSON string, NULL if it doesn't end */
+static const char * skip_string(const char * text) {
+    text ++;
+    while((*text != '"') && (*text != 0)) {
+        if((*text == '\\') && (text[1] != 0))
+            text ++;
+        text ++;
+    }
+    return (*text == '"') ? text +1 : NULL;
+}
+
+/* any JSON value. Objects of type Polygon or MultiPolygon add their coordinates
+ * to the area, other geometries like Point or LineString are passed over.
+ * Returns what follows the value, NULL if it is broken. */
+static const char * read_geojson_value(const char * text, struct polygon_area *area, int *polygon) {
+    const char * start;
+    text = skip_space(text);
+    if(*text == '"')
+        return skip_string(text);
+    if(*text == '[') {
+        text = skip_space(text +1);
+        if(*text == ']')
+            return text +1;
+        for(;;) {
+            text = read_geojson_value(text, area, polygon);
+            if(text == NULL)
+                return NULL;
+            text = skip_space(text);
+            if(*text == ']')
+                return text +1;
+            if(*text != ',')
+                return NULL;
+            text ++;
+        }
+    }
+    if(*text == '{') {
+        const char * coordinates = NULL;
+        int surface = 0;
+        text = skip_space(text +1);
+        if(*text == '}')
+            return text +1;
+        for(;;) {
+            const char * key = text;
+            const char * value;
+            if((*text != '"') || ((text = skip_string(text)) == NULL))
+                return NULL;
+            text = skip_space(text);
+            if(*text != ':')
+                return NULL;
+            value = skip_space(text +1);
+            /* the members come in any order, the type may follow the coordinates */
+            if(strncmp(key, "\"coordinates\"", strlen("\"coordinates\"")) == 0)
+                coordinates = value;
+            else if(strncmp(key, "\"type\"", strlen("\"type\"")) == 0)
+                surface = (strncmp(value, "\"Polygon\"", strlen("\"Polygon\"")) == 0)
+                          || (strncmp(value, "\"MultiPolygon\"", strlen("\"MultiPolygon\"")) == 0);
+            text = read_geojson_value(value, area, polygon);
+            if(text == NULL)
+                return NULL;
+            text = skip_space(text);
+            if(*text == '}')
+                break;
+            if(*text != ',')
+                return NULL;
+            text = skip_space(text +1);
+        }
+        if(surface && (coordinates != NULL) && (read_geojson_array(coordinates, area, polygon) == NULL))
+            return NULL;
+        return text +1;
+    }
+    /* number, true, false or null */
+    start = text;
+    while((*text != 0) && (strchr(",]} \t\r\n", *text) == NULL))
+        text ++;
+    return (text != start) ? text : NULL;
+}
+
+static int read_geojson(FILE *file, struct polygon_area *area) {
+    char * json = NULL;
+    size_t size = 0;
+    size_t used = 0;
+    const char * text;
+    int polygon = 0;
+
+    while(!feof(file)) {
+        if(used + 4096 + 1 > size) {
+            size = (size == 0) ? 65536 : size * 2;
+            json = realloc(json, size);
+        }
+        used += fread(json + used, 1, size - used -1, file);
+        if(ferror(file))
+            break;
+    }
+    if(json == NULL)
+        return -1;
+    json[used] = 0;
+    /* every polygon of a geometry, feature or feature collection */
+    text = read_geojson_value(json, area, &polygon);
+    if((text == NULL) || (*skip_space(text) != 0)) {
+        fprintf(stderr, "ERROR broken GeoJSON or polygon coordinates\n");
+        free(json);
+        return -1;
+    }
+    free(json);
+    return (area->count > 0) ? 0 : -1;
+}
+
+int polygon_area_read(const char *path, struct polygon_area *area) {
+    FILE * file;
+    int c;
+    int ret;
+
+    memset(area, 0, sizeof(*area));
+    file = fopen(path, "r");
+    if(file == NULL) {
+        fprintf(stderr, "ERROR opening %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    /* GeoJSON starts with an object, an Osmosis polygon with its name */
+    do {
+        c = fgetc(file);
+    } while(isspace(c));
+    ungetc(c, file);
+    if(c == '{')
+        ret = read_geojson(file, area);
+    else
+        ret = read_poly(file, area);
+    fclose(file);
+    if(ret != 0) {
+        fprintf(stderr, "ERROR no usable polygon in %s\n", path);
+        polygon_area_free(area);
+    }
+    return ret;
+}
+
+void polygon_area_free(struct polygon_area *area) {
+    int i;
+    for(i = 0; i < area->count; i ++)
+        free(area->rings[i].points);
+    if(area->rings != NULL)
+        free(area->rings);
+    memset(area, 0, sizeof(*area));
+}
+
+/* even-odd crossing test of one ring */
+static int ring_contains(struct polygon_ring *ring, int64_t x, int64_t y) {
+    int inside = 0;
+    int i;
+    int j;
+    for(i = 0, j = ring->count -1; i < ring->count; j = i ++) {
+        int64_t xi = ring->points[i].x, yi = ring->points[i].y;
+        int64_t xj = ring->points[j].x, yj = ring->points[j].y;
+        if(((yi > y) != (yj > y))
+                && ((x - xi) * (double)(yj - yi) < (double)(xj - xi) * (y - yi)) == (yj > yi))
+            inside = !inside;
+    }
+    return inside;
+}
+
+static int area_contains(struct polygon_area *area, int64_t x, int64_t y) {
+    int polygon;
+    int i;
+    for(polygon = 0; polygon < area->polygons; polygon ++) {
+        int outline = 0;
+        int hole = 0;
+        for(i = 0; i < area->count; i ++) {
+            struct polygon_ring * ring = &(area->rings[i]);
+            if((ring->polygon != polygon) || !ring_contains(ring, x, y))
+                continue;
+            if(ring->hole)
+                hole = 1;
+            else
+                outline = 1;
+        }
+        if(outline && !hole)
+            return 1;
+    }
+    return 0;
+}
+
+/* Liang-Barsky: does the segment a-b touch the rectangle */
+static int segment_intersects(struct coord *a, struct coord *b, struct rect *r) {
+    double t0 = 0;
+    double t1 = 1;
+    double dx = (double)b->x - a->x;
+    double dy = (double)b->y - a->y;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {(double)a->x - r->l.x, (double)r->h.x - a->x, (double)a->y - r->l.y, (double)r->h.y - a->y};
+    int i;
+    for(i = 0; i < 4; i ++) {
+        if(p[i] == 0) {
+            if(q[i] < 0)
+                return 0;
+        } else {
+            double t = q[i] / p[i];
+            if(p[i] < 0) {
+                if(t > t1)
+                    return 0;
+                if(t > t0)
+                    t0 = t;
+            } else {
+                if(t < t0)
+                    return 0;
+                if(t < t1)
+                    t1 = t;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief check if a rectangle overlaps a polygon area
+ *
+ * The rectangle overlaps if any edge of the area crosses it. If none does,
+ * it is either completely inside or completely outside, so testing one of
+ * its corners decides.
+ * @param[in] area - polygon area
+ * @param[in] r - rectangle
+ * @return 1 if they overlap, 0 otherwise
+ */
+int polygon_area_intersects(struct polygon_area *area, struct rect *r) {
+    int i;
+    int j;
+    if(!itembin_bbox_intersects(&(area->bbox), r))
+        return 0;
+    for(i = 0; i < area->count; i ++) {
+        struct polygon_ring * ring = &(area->rings[i]);
+        for(j = 0; j < ring->count; j ++) {
+            if(segment_intersects(&(ring->points[j]), &(ring->points[(j +1) % ring->count]), r))
+                return 1;
+        }
+    }
+    return area_contains(area, r->l.x, r->l.y);
+}
+
+/* rectangle completely inside the area: no edge crosses it and it isn't outside */
+int polygon_area_covers(struct polygon_area *area, struct rect *r) {
+    int i;
+    int j;
+    for(i = 0; i < area->count; i ++) {
+        struct polygon_ring * ring = &(area->rings[i]);
+        for(j = 0; j < ring->count; j ++) {
+            if(segment_intersects(&(ring->points[j]), &(ring->points[(j +1) % ring->count]), r))
+                return 0;
+        }
+    }
+    return area_contains(area, r->l.x, r->l.y);
+}
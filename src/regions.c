@@ -0,0 +1,161 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_REGION_SIMD
+#endif
+
+#include "regions.h"
+
+/* An area misses the tile if it lies completely left, right, below or above
+ * of it. The kernels compute these four for all lanes and set the bits of the
+ * lanes where none is true, like itembin_bbox_intersects(). */
+static void test_scalar(region_set_t * set, struct rect * bbox, uint64_t * hits) {
+    int i;
+    for(i = 0; i < set->count; i ++) {
+        if((set->lx[i] > bbox->h.x) || (bbox->l.x > set->hx[i]) || (set->hy[i] < bbox->l.y)
+                || (bbox->h.y < set->ly[i]))
+            continue;
+        hits[i >> 6] |= (uint64_t)1 << (i & 63);
+    }
+}
+
+#ifdef HAVE_REGION_SIMD
+__attribute__((target("sse2")))
+static void test_sse2(region_set_t * set, struct rect * bbox, uint64_t * hits) {
+    __m128i tlx = _mm_set1_epi32(bbox->l.x);
+    __m128i tly = _mm_set1_epi32(bbox->l.y);
+    __m128i thx = _mm_set1_epi32(bbox->h.x);
+    __m128i thy = _mm_set1_epi32(bbox->h.y);
+    int i;
+    for(i = 0; i < set->count; i += 4) {
+        __m128i outside = _mm_or_si128(
+                              _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((__m128i *)(set->lx + i)), thx),
+                                           _mm_cmpgt_epi32(tlx, _mm_loadu_si128((__m128i *)(set->hx + i)))),
+                              _mm_or_si128(_mm_cmpgt_epi32(tly, _mm_loadu_si128((__m128i *)(set->hy + i))),
+                                           _mm_cmpgt_epi32(_mm_loadu_si128((__m128i *)(set->ly + i)), thy)));
+        uint64_t inside = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xf;
+        hits[i >> 6] |= inside << (i & 63);
+    }
+}
+
+__attribute__((target("avx2")))
+static void test_avx2(region_set_t * set, struct rect * bbox, uint64_t * hits) {
+    __m256i tlx = _mm256_set1_epi32(bbox->l.x);
+    __m256i tly = _mm256_set1_epi32(bbox->l.y);
+    __m256i thx = _mm256_set1_epi32(bbox->h.x);
+    __m256i thy = _mm256_set1_epi32(bbox->h.y);
+    int i;
+    for(i = 0; i < set->count; i += 8) {
+        __m256i outside = _mm256_or_si256(
+                              _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i *)(set->lx + i)), thx),
+                                      _mm256_cmpgt_epi32(tlx, _mm256_loadu_si256((__m256i *)(set->hx + i)))),
+                              _mm256_or_si256(_mm256_cmpgt_epi32(tly, _mm256_loadu_si256((__m256i *)(set->hy + i))),
+                                      _mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i *)(set->ly + i)), thy)));
+        uint64_t inside = ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xff;
+        hits[i >> 6] |= inside << (i & 63);
+    }
+}
+#endif
+
+static int kernel_usable(int kernel) {
+    switch(kernel) {
+    case REGION_SCALAR:
+        return 1;
+#ifdef HAVE_REGION_SIMD
+    case REGION_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case REGION_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+int region_set_use(region_set_t * set, int kernel) {
+    if(kernel == REGION_AUTO) {
+        for(kernel = REGION_AVX2; !kernel_usable(kernel); kernel --)
+            ;
+    } else if(!kernel_usable(kernel))
+        return -1;
+    set->kernel = kernel;
+    return 0;
+}
+
+const char * region_kernel_name(int kernel) {
+    static const char * names[] = {"auto", "scalar", "sse2", "avx2"};
+    return ((kernel >= REGION_AUTO) && (kernel <= REGION_AVX2)) ? names[kernel] : "unknown";
+}
+
+int region_set_init(region_set_t * set, int count) {
+    int padded = (count + REGION_LANES -1) / REGION_LANES * REGION_LANES;
+    int i;
+    memset(set, 0, sizeof(*set));
+    if(padded == 0)
+        padded = REGION_LANES; /* malloc(0) may give NULL */
+    set->lx = malloc(4 * padded * sizeof(int32_t));
+    if(set->lx == NULL)
+        return -1;
+    set->ly = set->lx + padded;
+    set->hx = set->ly + padded;
+    set->hy = set->hx + padded;
+    for(i = 0; i < padded; i ++) {
+        set->lx[i] = set->ly[i] = INT32_MAX;
+        set->hx[i] = set->hy[i] = INT32_MIN;
+    }
+    set->count = count;
+    return region_set_use(set, REGION_AUTO);
+}
+
+void region_set_put(region_set_t * set, int i, struct rect * r) {
+    set->lx[i] = r->l.x;
+    set->ly[i] = r->l.y;
+    set->hx[i] = r->h.x;
+    set->hy[i] = r->h.y;
+}
+
+void region_set_free(region_set_t * set) {
+    free(set->lx);
+    memset(set, 0, sizeof(*set));
+}
+
+void region_set_test(region_set_t * set, struct rect * bbox, uint64_t * hits) {
+    memset(hits, 0, REGION_WORDS(set->count) * sizeof(uint64_t));
+    switch(set->kernel) {
+#ifdef HAVE_REGION_SIMD
+    case REGION_AVX2:
+        test_avx2(set, bbox, hits);
+        break;
+    case REGION_SSE2:
+        test_sse2(set, bbox, hits);
+        break;
+#endif
+    default:
+        test_scalar(set, bbox, hits);
+        break;
+    }
+}
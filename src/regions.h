@@ -0,0 +1,60 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __regions_h
+#define __regions_h
+#include <stdint.h>
+
+#include "map.h"
+
+/* Many areas against one tile at a time. The rects are kept as four arrays
+ * (structure of arrays), so a vector of low x, one of high x and so on can be
+ * compared with the tile in one go. The answer is a bitmask, bit i for area i. */
+#define REGION_LANES 8 /* arrays are padded to this with rects nothing touches */
+#define REGION_WORDS(count) (((count) + 63) / 64)
+#define REGION_HIT(hits, i) (((hits)[(i) >> 6] >> ((i) & 63)) & 1)
+
+enum region_kernel {
+    REGION_AUTO,
+    REGION_SCALAR,
+    REGION_SSE2,
+    REGION_AVX2,
+};
+
+typedef struct region_set region_set_t;
+struct region_set {
+    int32_t * lx;
+    int32_t * ly;
+    int32_t * hx;
+    int32_t * hy;
+    int count;
+    int kernel;  /* enum region_kernel, never AUTO */
+};
+
+/* count empty areas, the best kernel the CPU has */
+int region_set_init(region_set_t * set, int count);
+void region_set_put(region_set_t * set, int i, struct rect * r);
+void region_set_free(region_set_t * set);
+/* -1 if the CPU can't run it */
+int region_set_use(region_set_t * set, int kernel);
+const char * region_kernel_name(int kernel);
+/* bit i of hits is itembin_bbox_intersects(area i, bbox), hits has REGION_WORDS(count) words */
+void region_set_test(region_set_t * set, struct rect * bbox, uint64_t * hits);
+#endif
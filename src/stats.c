@@ -0,0 +1,124 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+static const char * phase_names[PHASE_COUNT] = {"header", "filter", "copy", "directory"};
+
+static double clock_seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void stats_init(run_statistics_t * stats, int timing, int verbose) {
+    memset(stats, 0, sizeof(*stats));
+    stats->timing = timing;
+    stats->verbose = verbose;
+    stats->phase = PHASE_NONE;
+}
+
+/* charge the time since the last change to the phase we leave.
+ * CPU time is the main thread's, the workers show in the process total. */
+void stats_phase(run_statistics_t * stats, int phase) {
+    double wall;
+    double cpu;
+    if(!stats->timing || (phase == stats->phase))
+        return;
+    wall = clock_seconds(CLOCK_MONOTONIC);
+    cpu = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+    if(stats->phase != PHASE_NONE) {
+        stats->wall[stats->phase] += wall - stats->phase_wall;
+        stats->cpu[stats->phase] += cpu - stats->phase_cpu;
+    }
+    stats->phase = phase;
+    stats->phase_wall = wall;
+    stats->phase_cpu = cpu;
+}
+
+void stats_tile(run_statistics_t * stats, const char * name, int depth, int kept, int placeholders) {
+    if(depth >= STATS_DEPTHS)
+        depth = STATS_DEPTHS -1;
+    if(kept) {
+        stats->kept[depth] ++;
+        if(stats->verbose > 1)
+            fprintf(stderr, "keep %s\n", name);
+    } else if(placeholders)
+        stats->placeholders[depth] ++;
+    else
+        stats->dropped[depth] ++;
+}
+
+static void write_tiles(run_statistics_t * stats, FILE * outfile) {
+    int depth;
+    int first = 1;
+    fprintf(outfile, "\"tiles\":[");
+    for(depth = 0; depth < STATS_DEPTHS; depth ++) {
+        if((stats->kept[depth] == 0) && (stats->placeholders[depth] == 0) && (stats->dropped[depth] == 0))
+            continue;
+        fprintf(outfile, "%s{\"depth\":%d,\"kept\":%ld,\"placeholder\":%ld,\"dropped\":%ld}", first ? "" : ",",
+                depth, stats->kept[depth], stats->placeholders[depth], stats->dropped[depth]);
+        first = 0;
+    }
+    fprintf(outfile, "]");
+}
+
+/* one line, so it can be picked out of the other messages */
+void stats_write_json(run_statistics_t * stats, FILE * outfile) {
+    static const char * copy_names[COPY_METHOD_COUNT] = {"buffered", "copy_file_range", "splice", "sendfile"};
+    struct rusage usage;
+    int i;
+
+    stats_phase(stats, PHASE_NONE);
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(outfile, "{\"bytes\":{\"read\":%ld,\"skipped\":%ld,\"written\":%ld},", stats->bytes_read,
+            stats->bytes_skipped, stats->bytes_written);
+    write_tiles(stats, outfile);
+    fprintf(outfile, ",\"copy\":{");
+    for(i = 0; i < COPY_METHOD_COUNT; i ++)
+        fprintf(outfile, "%s\"%s\":%ld", (i > 0) ? "," : "", copy_names[i], stats->copy.bytes[i]);
+    fprintf(outfile, "}");
+    if(stats->rewritten > 0)
+        fprintf(outfile, ",\"rewritten\":{\"tiles\":%ld,\"before\":%ld,\"after\":%ld,\"items\":%ld,\"dropped\":%ld}",
+                stats->rewritten, stats->rewritten_before, stats->rewritten_after, stats->items, stats->items_dropped);
+    if(stats->gaps > 0)
+        fprintf(outfile, ",\"resync\":{\"gaps\":%ld,\"bytes\":%ld}", stats->gaps, stats->gap_bytes);
+    if(stats->verify)
+        fprintf(outfile, ",\"verify\":{\"tiles\":%ld,\"bytes\":%ld,\"mismatches\":%ld,\"unsupported\":%ld}",
+                stats->verified, stats->verified_bytes, stats->crc_mismatches, stats->unverified);
+    if(stats->timing) {
+        fprintf(outfile, ",\"phases\":{");
+        for(i = 0; i < PHASE_COUNT; i ++)
+            fprintf(outfile, "%s\"%s\":{\"wall\":%.6f,\"cpu\":%.6f}", (i > 0) ? "," : "", phase_names[i],
+                    stats->wall[i], stats->cpu[i]);
+        fprintf(outfile, "}");
+    }
+    fprintf(outfile, ",\"cpu\":{\"user\":%.6f,\"system\":%.6f},\"peak_rss_kb\":%ld}\n",
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+            usage.ru_maxrss);
+    fflush(outfile);
+}
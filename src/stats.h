@@ -0,0 +1,76 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __stats_h
+#define __stats_h
+#include <stdio.h>
+#include <stdint.h>
+
+#include "zipfile.h"
+
+/* deeper tiles are counted with the deepest */
+#define STATS_DEPTHS 32
+
+enum run_phase {
+    PHASE_NONE = -1,
+    PHASE_HEADER,       /* parsing headers and the directory */
+    PHASE_FILTER,
+    PHASE_COPY,         /* tile data, including clipping and parallel copies */
+    PHASE_DIRECTORY,    /* writing central directories */
+    PHASE_COUNT
+};
+
+/* What happened during a run. Phase times are only taken if timing is set,
+ * as the CPU clock costs a system call on every phase change. */
+typedef struct run_statistics run_statistics_t;
+struct run_statistics {
+    int timing;
+    int verbose;        /* > 1 names every kept tile */
+    int verify;         /* check the CRC of the kept tiles */
+    uint64_t bytes_read;
+    uint64_t bytes_skipped;
+    uint64_t bytes_written;
+    uint64_t kept[STATS_DEPTHS];         /* tiles with data in an output */
+    uint64_t placeholders[STATS_DEPTHS]; /* tiles written as empty entries only */
+    uint64_t dropped[STATS_DEPTHS];      /* tiles in no output at all */
+    uint64_t verified;
+    uint64_t verified_bytes;
+    uint64_t crc_mismatches;
+    uint64_t unverified;                 /* kept tiles without a CRC we can check */
+    uint64_t rewritten;                  /* tiles clipped or deflated again */
+    uint64_t rewritten_before;           /* their compressed bytes in the input */
+    uint64_t rewritten_after;
+    uint64_t items;                      /* in the clipped tiles */
+    uint64_t items_dropped;
+    uint64_t gaps;                       /* stretches of unknown data in a streamed binfile */
+    uint64_t gap_bytes;
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];
+    int phase;
+    double phase_wall;
+    double phase_cpu;
+    copy_statistics_t copy;
+};
+
+void stats_init(run_statistics_t * stats, int timing, int verbose);
+void stats_phase(run_statistics_t * stats, int phase);
+void stats_tile(run_statistics_t * stats, const char * name, int depth, int kept, int placeholders);
+void stats_write_json(run_statistics_t * stats, FILE * outfile);
+#endif
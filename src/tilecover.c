@@ -0,0 +1,119 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tilecover.h"
+
+typedef struct cover cover_t;
+struct cover {
+    tile_index_t * index;
+    cover_area_t * areas;
+    int count;
+    uint8_t * candidates;
+    uint64_t selected;
+};
+
+static const unsigned char * sorted_name(cover_t * cover, uint64_t i) {
+    tile_index_t * index = cover->index;
+    return (const unsigned char *)index->names + index->entries[index->sorted[i]].name_offset;
+}
+
+/* the names in [low, high) share depth characters, first one whose next is not below c */
+static uint64_t next_at_least(cover_t * cover, uint64_t low, uint64_t high, int depth, unsigned char c) {
+    while(low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if(sorted_name(cover, middle)[depth] < c)
+            low = middle +1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+static void take(cover_t * cover, uint64_t low, uint64_t high) {
+    uint64_t i;
+    for(i = low; i < high; i ++)
+        cover->candidates[cover->index->sorted[i]] = 1;
+    cover->selected += high - low;
+}
+
+static int rect_inside(struct rect * inner, struct rect * outer) {
+    return (inner->l.x >= outer->l.x) && (inner->l.y >= outer->l.y) && (inner->h.x <= outer->h.x)
+           && (inner->h.y <= outer->h.y);
+}
+
+static void cover_prefix(cover_t * cover, struct rect * bbox, int depth, uint64_t low, uint64_t high);
+
+/* [low, high) are the names going on from a prefix of depth letters with the bbox
+ * given. The prefix itself and names going on with anything but a quadrant are
+ * left to the filter, the quadrants are looked into. */
+static void cover_quadrants(cover_t * cover, struct rect * bbox, int depth, uint64_t low, uint64_t high) {
+    uint64_t first = next_at_least(cover, low, high, depth, 'a');
+    uint64_t last = next_at_least(cover, first, high, depth, 'd' +1);
+    char quadrant;
+
+    take(cover, low, first);
+    take(cover, last, high);
+    for(quadrant = 'a'; quadrant <= 'd'; quadrant ++) {
+        uint64_t end = next_at_least(cover, first, last, depth, quadrant +1);
+        if(end > first) {
+            struct rect child = *bbox;
+            tile_step(&child, quadrant, 1);
+            cover_prefix(cover, &child, depth +1, first, end);
+        }
+        first = end;
+    }
+}
+
+static void cover_prefix(cover_t * cover, struct rect * bbox, int depth, uint64_t low, uint64_t high) {
+    int touched = 0;
+    int i;
+    for(i = 0; i < cover->count; i ++) {
+        cover_area_t * area = &(cover->areas[i]);
+        if(((area->depth >= 0) && (depth > area->depth)) || !itembin_bbox_intersects(&(area->rect), bbox))
+            continue;
+        if((area->depth < 0) && rect_inside(bbox, &(area->rect))) {
+            take(cover, low, high);
+            return;
+        }
+        touched = 1;
+    }
+    if(touched)
+        cover_quadrants(cover, bbox, depth, low, high);
+}
+
+uint64_t tile_cover_select(tile_index_t * index, cover_area_t * areas, int count, uint8_t * candidates) {
+    cover_t cover;
+    struct rect world;
+
+    cover.index = index;
+    cover.areas = areas;
+    cover.count = count;
+    cover.candidates = candidates;
+    cover.selected = 0;
+    memset(candidates, 0, index->count);
+    tile_bbox("", &world, 1);
+    /* names not starting with a quadrant are depth 0 and kept anyway */
+    cover_quadrants(&cover, &world, 0, 0, index->count);
+    return cover.selected;
+}
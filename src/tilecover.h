@@ -0,0 +1,45 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __tilecover_h
+#define __tilecover_h
+#include <stdint.h>
+
+#include "tileindex.h"
+#include "map.h"
+
+/* Which tiles of an index may touch some areas, without looking at all of
+ * them. Tile names are quadtree paths and every letter cuts the bbox of the
+ * name so far, so the bbox of a tile lies inside the ones of all its
+ * prefixes. A prefix whose bbox misses the areas rules out every tile below
+ * it, one whose bbox is inside an area takes them all. Only the prefixes in
+ * between are split further. Each prefix is a range of the names in sorted
+ * order, found by binary search within the range of its parent. */
+typedef struct cover_area cover_area_t;
+struct cover_area {
+    struct rect rect;
+    int depth;   /* deepest tiles taken, -1 for all */
+};
+
+/* needs tile_index_sort(). Sets candidates[n] for each entry n that may
+ * touch an area and for the tiles of depth 0, which are always kept. The
+ * others touch none. Returns how many were set. */
+uint64_t tile_cover_select(tile_index_t * index, cover_area_t * areas, int count, uint8_t * candidates);
+#endif
@@ -0,0 +1,192 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "tileindex.h"
+
+int tile_index_from_directory(tile_index_t * index, central_directory_t * directory) {
+    uint64_t i;
+    uint64_t used = 0;
+    tile_walk_t walk;
+
+    memset(index, 0, sizeof(*index));
+    tile_walk_init(&walk, 1);
+    /* NavIT numbers the tiles in directory order, the output has to keep it. It is
+     * the archive order unless tiles were clipped or share a placeholder header. */
+    for(i = 0; i < directory->count; i ++)
+        index->names_size += directory->entries[i].header->file_name_length +1;
+    if(index->names_size > UINT32_MAX)
+        return -1;
+    index->entries = calloc(directory->count, sizeof(tile_index_entry_t));
+    index->names = malloc(index->names_size);
+    if((index->entries == NULL) || (index->names == NULL)) {
+        tile_index_free(index);
+        return -1;
+    }
+    for(i = 0; i < directory->count; i ++) {
+        central_directory_header_t * header = directory->entries[i].header;
+        tile_index_entry_t * entry = &(index->entries[i]);
+        char * name = index->names + used;
+
+        memcpy(name, header +1, header->file_name_length);
+        name[header->file_name_length] = 0;
+        used += header->file_name_length +1;
+
+        tile_walk_bbox(&walk, name, &(entry->bbox));
+        entry->offset = directory->entries[i].offset;
+        entry->compressed_size = directory->entries[i].compressed_size;
+        entry->crc32 = header->crc32;
+        entry->name_offset = name - index->names;
+        entry->name_length = header->file_name_length;
+        entry->depth = tile_len(name);
+        entry->version_needed_to_extract = header->version_needed_to_extract;
+        entry->general_purpose_bit_flag = header->general_purpose_bit_flag;
+        entry->last_mod_file_time = header->last_mod_file_time;
+        entry->last_mod_file_date = header->last_mod_file_date;
+        entry->compression_method = header->compression_method;
+    }
+    index->count = directory->count;
+    return 0;
+}
+
+int tile_index_write(tile_index_t * index, struct stat * binfile, FILE * outfile) {
+    tile_index_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TILE_INDEX_MAGIC, sizeof(header.magic));
+    header.version = TILE_INDEX_VERSION;
+    header.entry_size = sizeof(tile_index_entry_t);
+    header.binfile_size = binfile->st_size;
+    header.binfile_mtime_sec = binfile->st_mtim.tv_sec;
+    header.binfile_mtime_nsec = binfile->st_mtim.tv_nsec;
+    header.count = index->count;
+    header.names_offset = sizeof(header) + index->count * sizeof(tile_index_entry_t);
+    header.names_size = index->names_size;
+
+    if((fwrite(&header, sizeof(header), 1, outfile) != 1)
+            || (fwrite(index->entries, sizeof(tile_index_entry_t), index->count, outfile) != index->count)
+            || (fwrite(index->names, 1, index->names_size, outfile) != index->names_size)) {
+        fprintf(stderr, "ERROR writing index: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int tile_index_open(tile_index_t * index, const char * path, struct stat * binfile) {
+    struct stat st;
+    tile_index_header_t * header;
+    const char * problem = NULL;
+    int fd;
+
+    memset(index, 0, sizeof(*index));
+    fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        fprintf(stderr, "ERROR opening index %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(*header))) {
+        fprintf(stderr, "ERROR index %s too short\n", path);
+        close(fd);
+        return -1;
+    }
+    index->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(index->map == MAP_FAILED) {
+        fprintf(stderr, "ERROR mapping index %s: %s\n", path, strerror(errno));
+        index->map = NULL;
+        return -1;
+    }
+    index->map_size = st.st_size;
+    header = index->map;
+
+    if(memcmp(header->magic, TILE_INDEX_MAGIC, sizeof(header->magic)) != 0)
+        problem = "not an index";
+    else if((header->version != TILE_INDEX_VERSION) || (header->entry_size != sizeof(tile_index_entry_t)))
+        problem = "unsupported version";
+    else if((header->names_offset != sizeof(*header) + header->count * sizeof(tile_index_entry_t))
+            || (header->names_offset + header->names_size != index->map_size))
+        problem = "truncated";
+    else if((header->binfile_size != (uint64_t)binfile->st_size)
+            || (header->binfile_mtime_sec != binfile->st_mtim.tv_sec)
+            || (header->binfile_mtime_nsec != binfile->st_mtim.tv_nsec))
+        problem = "made for a different binfile";
+    if(problem != NULL) {
+        fprintf(stderr, "index %s %s, ignored\n", path, problem);
+        tile_index_free(index);
+        return -1;
+    }
+    index->entries = (tile_index_entry_t *)(header +1);
+    index->names = (char *)index->map + header->names_offset;
+    index->count = header->count;
+    index->names_size = header->names_size;
+    return 0;
+}
+
+void tile_index_free(tile_index_t * index) {
+    free(index->sorted);
+    if(index->map != NULL) {
+        munmap(index->map, index->map_size);
+    } else {
+        if(index->entries != NULL)
+            free(index->entries);
+        if(index->names != NULL)
+            free(index->names);
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+static int compare_names(const void * a, const void * b, void * context) {
+    tile_index_t * index = context;
+    return strcmp(index->names + index->entries[*(const uint32_t *)a].name_offset,
+                  index->names + index->entries[*(const uint32_t *)b].name_offset);
+}
+
+/* directory order is NavIT's, the cover of an area needs the names sorted */
+int tile_index_sort(tile_index_t * index) {
+    uint64_t i;
+    if(index->count > UINT32_MAX)
+        return -1;
+    free(index->sorted);
+    index->sorted = malloc(index->count * sizeof(uint32_t));
+    if(index->sorted == NULL)
+        return -1;
+    for(i = 0; i < index->count; i ++)
+        index->sorted[i] = i;
+    qsort_r(index->sorted, index->count, sizeof(uint32_t), compare_names, index);
+    return 0;
+}
+
+/* empty local file header for a rejected tile, without touching the binfile */
+local_file_header_t * tile_index_placeholder(tile_index_t * index, tile_index_entry_t * entry,
+        local_file_header_storage_t * storage) {
+    return placeholder_header(storage, index->names + entry->name_offset, entry->name_length,
+                              entry->general_purpose_bit_flag, entry->last_mod_file_time, entry->last_mod_file_date);
+}
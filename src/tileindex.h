@@ -0,0 +1,86 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __tileindex_h
+#define __tileindex_h
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "zipfile.h"
+#include "map.h"
+
+/* Sidecar file layout, little endian like the zip structures:
+ *   tile_index_header_t
+ *   tile_index_entry_t[count], in central directory order
+ *   zero terminated tile names, referenced by name_offset
+ * The binfile is identified by size and modification time. */
+#define TILE_INDEX_MAGIC "NAVITIDX"
+#define TILE_INDEX_VERSION 2
+
+typedef struct tile_index_header tile_index_header_t;
+struct tile_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t binfile_size;
+    int64_t binfile_mtime_sec;
+    int64_t binfile_mtime_nsec;
+    uint64_t count;
+    uint64_t names_offset;
+    uint64_t names_size;
+};
+
+typedef struct tile_index_entry tile_index_entry_t;
+struct tile_index_entry {
+    struct rect bbox;       /* tile_bbox() with 1% overlap */
+    uint64_t offset;        /* of the local file header */
+    uint64_t compressed_size;
+    uint32_t crc32;
+    uint32_t name_offset;
+    uint16_t name_length;
+    uint16_t depth;         /* tile_len() */
+    uint16_t version_needed_to_extract;
+    uint16_t general_purpose_bit_flag;
+    uint16_t last_mod_file_time;
+    uint16_t last_mod_file_date;
+    uint16_t compression_method;
+    uint16_t reserved;
+};
+
+typedef struct tile_index tile_index_t;
+struct tile_index {
+    tile_index_entry_t * entries;
+    char * names;
+    uint64_t count;
+    uint64_t names_size;
+    void * map;          /* sidecar mapping, NULL if built in memory */
+    uint64_t map_size;
+    uint32_t * sorted;   /* entry numbers in name order, NULL until tile_index_sort() */
+};
+
+int tile_index_from_directory(tile_index_t * index, central_directory_t * directory);
+int tile_index_write(tile_index_t * index, struct stat * binfile, FILE * outfile);
+int tile_index_open(tile_index_t * index, const char * path, struct stat * binfile);
+void tile_index_free(tile_index_t * index);
+int tile_index_sort(tile_index_t * index);
+local_file_header_t * tile_index_placeholder(tile_index_t * index, tile_index_entry_t * entry,
+        local_file_header_storage_t * storage);
+#endif
@@ -0,0 +1,307 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_CRC_CLMUL
+#endif
+
+#include "verify.h"
+
+#define METHOD_STORED 0
+#define METHOD_DEFLATED 8
+#define FLAG_DATA_DESCRIPTOR 0x0008
+/* inflated in pieces of this, nothing but the CRC is kept */
+#define VERIFY_CHUNK (256*1024)
+
+#ifdef HAVE_CRC_CLMUL
+/* Folding with carry-less multiplication, see Intel's "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction". Four 128 bit lanes are
+ * folded 64 bytes at a time, then into one and Barrett reduced. Takes and gives
+ * the CRC register itself, the inversions are left to the caller. size is at
+ * least 64 and a multiple of 16. */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc_fold(const unsigned char * data, uint64_t size, uint32_t crc) {
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = {0x0163cd6124, 0x0000000000};
+    static const uint64_t __attribute__((aligned(16))) poly[] = {0x01db710641, 0x01f7011641};
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    __m128i mask;
+
+    x1 = _mm_loadu_si128((const __m128i *)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    data += 64;
+    size -= 64;
+
+    while(size >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(data + 0x30)));
+        data += 64;
+        size -= 64;
+    }
+
+    /* four lanes into one */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while(size >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        size -= 16;
+    }
+
+    /* 128 bits to 64 */
+    mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 */
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return _mm_extract_epi32(x1, 1);
+}
+
+static int crc_fold_usable(void) {
+    static int usable = -1;
+    if(usable < 0)
+        usable = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return usable;
+}
+#endif
+
+uint32_t crc_update(uint32_t crc, const char * data, uint64_t size) {
+#ifdef HAVE_CRC_CLMUL
+    if((size >= 64) && crc_fold_usable()) {
+        uint64_t folded = size & ~(uint64_t)15;
+        crc = ~crc_fold((const unsigned char *)data, folded, ~crc);
+        data += folded;
+        size -= folded;
+    }
+#endif
+    /* the rest, or everything on CPUs without carry-less multiplication */
+    while(size > 0) {
+        uInt chunk = (size > (1u << 30)) ? (1u << 30) : size;
+        crc = crc32(crc, (const Bytef *)data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+/* raw deflate stream as found in zip files, -1 if it is broken */
+static int inflate_crc(verify_job_t * job, char * buffer, uint32_t * crc) {
+    z_stream stream;
+    int ret;
+
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return -1;
+    stream.next_in = (Bytef *)job->input->data;
+    stream.avail_in = job->input->size;
+    *crc = 0;
+    do {
+        stream.next_out = (Bytef *)buffer;
+        stream.avail_out = VERIFY_CHUNK;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        *crc = crc_update(*crc, buffer, VERIFY_CHUNK - stream.avail_out);
+    } while(ret == Z_OK);
+    inflateEnd(&stream);
+    return (ret == Z_STREAM_END) ? 0 : -1;
+}
+
+/* called with the lock held, which guards the counters */
+static void verify_job_run(verify_lane_t * lane, verify_job_t * job, char * buffer) {
+    uint32_t crc = 0;
+    int ret = 0;
+
+    if((job->compression_method != METHOD_STORED) && (job->compression_method != METHOD_DEFLATED)) {
+        lane->unsupported ++;
+        return;
+    }
+    pthread_mutex_unlock(&(lane->lock));
+    if(job->compression_method == METHOD_STORED)
+        crc = crc_update(0, job->input->data, job->input->size);
+    else
+        ret = inflate_crc(job, buffer, &crc);
+    pthread_mutex_lock(&(lane->lock));
+    lane->tiles ++;
+    lane->bytes += job->input->size;
+    if(ret != 0) {
+        fprintf(stderr, "ERROR tile %s: broken deflate stream\n", job->name);
+        lane->mismatches ++;
+    } else if(crc != job->crc32) {
+        fprintf(stderr, "ERROR tile %s: crc %08x, header says %08x\n", job->name, crc, job->crc32);
+        lane->mismatches ++;
+    }
+}
+
+static void verify_job_free(verify_job_t * job) {
+    clip_data_release(job->input);
+    free(job->name);
+    free(job);
+}
+
+static void * verify_worker(void * data) {
+    verify_lane_t * lane = data;
+    char * buffer = malloc(VERIFY_CHUNK);
+
+    pthread_mutex_lock(&(lane->lock));
+    while(1) {
+        verify_job_t * job;
+        while((lane->first == NULL) && !lane->stop)
+            pthread_cond_wait(&(lane->work), &(lane->lock));
+        job = lane->first;
+        if(job == NULL)
+            break;
+        lane->first = job->next;
+        if(lane->first == NULL)
+            lane->last = NULL;
+        lane->active ++;
+        verify_job_run(lane, job, buffer);
+        lane->active --;
+        if(job->input->owned)
+            lane->backlog -= job->input->size;
+        pthread_cond_broadcast(&(lane->room));
+        verify_job_free(job);
+    }
+    pthread_mutex_unlock(&(lane->lock));
+    free(buffer);
+    return NULL;
+}
+
+int verify_lane_start(verify_lane_t * lane, int threads) {
+    memset(lane, 0, sizeof(*lane));
+    pthread_mutex_init(&(lane->lock), NULL);
+    pthread_cond_init(&(lane->work), NULL);
+    pthread_cond_init(&(lane->room), NULL);
+    lane->threads = calloc(threads, sizeof(pthread_t));
+    for(lane->count = 0; lane->count < threads; lane->count ++)
+        if(pthread_create(&(lane->threads[lane->count]), NULL, verify_worker, lane) != 0)
+            break;
+    return lane->count;
+}
+
+void verify_lane_submit(verify_lane_t * lane, clip_data_t * input, local_file_header_t * header, const char * name) {
+    verify_job_t * job;
+
+    /* with a data descriptor the header has no CRC to check against */
+    if(header->general_purpose_bit_flag & FLAG_DATA_DESCRIPTOR) {
+        pthread_mutex_lock(&(lane->lock));
+        lane->unsupported ++;
+        pthread_mutex_unlock(&(lane->lock));
+        return;
+    }
+    job = calloc(1, sizeof(*job));
+    job->input = input;
+    __atomic_add_fetch(&(input->references), 1, __ATOMIC_RELAXED);
+    job->name = strdup(name);
+    job->compression_method = header->compressionmethod;
+    job->crc32 = header->crc32;
+    pthread_mutex_lock(&(lane->lock));
+    if(lane->count == 0) {
+        /* no thread to be had, do it ourselves */
+        if(lane->buffer == NULL)
+            lane->buffer = malloc(VERIFY_CHUNK);
+        verify_job_run(lane, job, lane->buffer);
+        pthread_mutex_unlock(&(lane->lock));
+        verify_job_free(job);
+        return;
+    }
+    if(input->owned) {
+        /* don't let a fast pipe run away from the checks */
+        while((lane->backlog > 0) && (lane->backlog + input->size > VERIFY_BACKLOG))
+            pthread_cond_wait(&(lane->room), &(lane->lock));
+        lane->backlog += input->size;
+    }
+    if(lane->last != NULL)
+        lane->last->next = job;
+    else
+        lane->first = job;
+    lane->last = job;
+    pthread_cond_signal(&(lane->work));
+    pthread_mutex_unlock(&(lane->lock));
+}
+
+void verify_lane_drain(verify_lane_t * lane) {
+    pthread_mutex_lock(&(lane->lock));
+    while((lane->first != NULL) || (lane->active > 0))
+        pthread_cond_wait(&(lane->room), &(lane->lock));
+    pthread_mutex_unlock(&(lane->lock));
+}
+
+void verify_lane_finish(verify_lane_t * lane) {
+    int i;
+    pthread_mutex_lock(&(lane->lock));
+    lane->stop = 1;
+    pthread_cond_broadcast(&(lane->work));
+    pthread_mutex_unlock(&(lane->lock));
+    for(i = 0; i < lane->count; i ++)
+        pthread_join(lane->threads[i], NULL);
+    free(lane->threads);
+    free(lane->buffer);
+    lane->threads = NULL;
+    lane->buffer = NULL;
+    lane->count = 0;
+    pthread_mutex_destroy(&(lane->lock));
+    pthread_cond_destroy(&(lane->work));
+    pthread_cond_destroy(&(lane->room));
+}
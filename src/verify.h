@@ -0,0 +1,72 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __verify_h
+#define __verify_h
+#include <stdint.h>
+#include <pthread.h>
+
+#include "zipfile.h"
+#include "clip.h"
+
+/* --verify: the CRC of every kept tile is checked against its local file
+ * header on threads of their own while the main thread copies. Deflated tiles
+ * are inflated for it, the zip CRC is the one of the uncompressed data. */
+
+/* data copied from a pipe waiting for the lane, the input stops beyond this */
+#define VERIFY_BACKLOG (64*1024*1024)
+
+typedef struct verify_job verify_job_t;
+struct verify_job {
+    verify_job_t * next;
+    clip_data_t * input;
+    char * name;
+    uint16_t compression_method;
+    uint32_t crc32;
+};
+
+typedef struct verify_lane verify_lane_t;
+struct verify_lane {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t room;
+    pthread_t * threads;
+    int count;
+    char * buffer;          /* inflating without threads */
+    int stop;
+    verify_job_t * first;
+    verify_job_t * last;
+    uint64_t backlog;       /* bytes of private copies queued */
+    int active;             /* jobs being checked */
+    uint64_t tiles;
+    uint64_t bytes;         /* compressed bytes checked */
+    uint64_t mismatches;
+    uint64_t unsupported;   /* compression methods we can't inflate */
+};
+
+/* zlib compatible, crc_update(0, data, size) is the zip CRC of data */
+uint32_t crc_update(uint32_t crc, const char * data, uint64_t size);
+int verify_lane_start(verify_lane_t * lane, int threads);
+void verify_lane_submit(verify_lane_t * lane, clip_data_t * input, local_file_header_t * header, const char * name);
+/* wait for the checks submitted so far */
+void verify_lane_drain(verify_lane_t * lane);
+/* wait for all checks, the counters are final afterwards */
+void verify_lane_finish(verify_lane_t * lane);
+#endif
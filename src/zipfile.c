@@ -18,13 +18,20 @@
  * Boston, MA  02110-1301, USA.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <malloc.h>
 #include <string.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
 
 #include "zipfile.h"
+#include "input.h"
 
 #ifndef NAVIT_COMPATIBLE
 #define NAVIT_COMPATIBLE 1
@@ -65,6 +72,35 @@ uint64_t get_file_length (local_file_header_t  *header) {
     return filesize;
 }
 
+/* Binfiles are written by maptool: tiles needing zip 1.0 or 4.5 (10 or 45,
+ * the latter for zip64), nothing later. Stored or deflated, nothing
+ * encrypted, short printable names. Random data rarely gets all of these
+ * right. */
+static int plausible_entry (uint16_t version_needed_to_extract, uint16_t general_purpose_bit_flag,
+                            uint16_t compression_method, const unsigned char *name, uint16_t name_length) {
+    uint16_t i;
+    if((version_needed_to_extract > 45) || (general_purpose_bit_flag & 0x0001)
+            || ((compression_method != 0) && (compression_method != 8))
+            || (name_length == 0) || (name_length >= 1024))
+        return 0;
+    for(i = 0; i < name_length; i ++) {
+        if((name[i] < 0x20) || (name[i] > 0x7e))
+            return 0;
+    }
+    return 1;
+}
+
+int plausible_local_file_header (local_file_header_t *header) {
+    return plausible_entry(header->version_needed_to_extract, header->general_purpose_bit_flag,
+                           header->compressionmethod, (const unsigned char *)(header +1), header->file_name_length);
+}
+
+int plausible_central_directory_header (central_directory_header_t *header) {
+    return ((header->version_made_by & 0xff) <= 63)
+           && plausible_entry(header->version_needed_to_extract, header->general_purpose_bit_flag,
+                              header->compression_method, (const unsigned char *)(header +1), header->file_name_length);
+}
+
 void patch_file_length (uint64_t offset, local_file_header_t  *header, uint64_t filesize) {
     zip64_extended_information_t * zip64_extended = NULL;
     /* check for 64 bit extension */
@@ -94,18 +130,21 @@ void patch_file_length (uint64_t offset, local_file_header_t  *header, uint64_t
     }
 }
 
-uint64_t copy_file_data (uint64_t size, FILE* infile, FILE*outfile) {
+static uint64_t copy_file_data_buffered (uint64_t size, FILE* infile, FILE*outfile) {
     uint64_t bsize = 10*1024*1024;
     uint64_t copied = 0;
-    char * buffer = malloc(bsize);
+    char * buffer;
 
+    if(bsize > size)
+        bsize = size;
+    buffer = malloc(bsize);
     while(copied < size) {
-        uint64_t to_read = size;
+        uint64_t to_read = size - copied;
         if(to_read > bsize)
             to_read = bsize;
         errno = 0;
         if(fread(buffer, 1, to_read, infile) != to_read) {
-            fprintf(stderr, "ERROR reading: %s\n", strerror(errno));
+            fprintf(stderr, "ERROR reading: %s\n", feof(infile) ? "end of file" : strerror(errno));
             free(buffer);
             return -1;
         } else {
@@ -124,6 +163,115 @@ uint64_t copy_file_data (uint64_t size, FILE* infile, FILE*outfile) {
     return size;
 }
 
+/* number of bytes stdio has read ahead from the file descriptor */
+static uint64_t stdio_read_ahead (FILE *infile) {
+#ifdef __GLIBC__
+    return infile->_IO_read_end - infile->_IO_read_ptr;
+#else
+    return -1;
+#endif
+}
+
+/* move size bytes between the descriptors inside the kernel, returns bytes moved before failing */
+static uint64_t copy_file_data_kernel (uint64_t size, int in, loff_t *in_offset, int out, int method) {
+    uint64_t copied = 0;
+    while(copied < size) {
+        ssize_t done;
+        size_t chunk = size - copied;
+        if(chunk > 0x40000000)
+            chunk = 0x40000000;
+        switch(method) {
+        case COPY_METHOD_COPY_FILE_RANGE:
+            done = copy_file_range(in, in_offset, out, NULL, chunk, 0);
+            break;
+        case COPY_METHOD_SPLICE:
+            done = splice(in, in_offset, out, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+            break;
+        default:
+            done = sendfile(out, in, in_offset, chunk);
+            break;
+        }
+        if(done < 0 && errno == EINTR)
+            continue;
+        if(done <= 0)
+            break;
+        copied += done;
+    }
+    return copied;
+}
+
+/* pick the cheapest way the kernel offers to move data between these two */
+static int copy_method (FILE* infile, FILE*outfile) {
+    struct stat in;
+    struct stat out;
+    if((fstat(fileno(infile), &in) != 0) || (fstat(fileno(outfile), &out) != 0))
+        return COPY_METHOD_BUFFERED;
+    if(S_ISREG(in.st_mode)) {
+        if(S_ISREG(out.st_mode))
+            return COPY_METHOD_COPY_FILE_RANGE;
+        if(S_ISFIFO(out.st_mode))
+            return COPY_METHOD_SPLICE;
+        return COPY_METHOD_SENDFILE;
+    }
+    if(S_ISFIFO(in.st_mode) || S_ISFIFO(out.st_mode))
+        return COPY_METHOD_SPLICE;
+    return COPY_METHOD_BUFFERED;
+}
+
+uint64_t copy_file_data (uint64_t size, FILE* infile, FILE*outfile, copy_statistics_t *stats) {
+    int method;
+    uint64_t copied = 0;
+    uint64_t ahead = 0;
+    loff_t offset;
+    loff_t * in_offset = NULL;
+
+    if((outfile == NULL) || (size == 0))
+        return copy_file_data_buffered(size, infile, outfile);
+
+    method = copy_method(infile, outfile);
+    if(method != COPY_METHOD_BUFFERED) {
+        offset = ftello(infile);
+        if(offset >= 0) {
+            /* seekable: address the input by offset, stdio's read ahead doesn't matter */
+            in_offset = &offset;
+        } else {
+            /* pipe: hand out what stdio already holds, the rest comes from the descriptor */
+            ahead = stdio_read_ahead(infile);
+            if(ahead > size)
+                ahead = size;
+            if(copy_file_data_buffered(ahead, infile, outfile) != ahead)
+                return -1;
+            if(stats != NULL)
+                stats->bytes[COPY_METHOD_BUFFERED] += ahead;
+            copied = ahead;
+        }
+        if(copied < size) {
+            fflush(outfile);
+            copied += copy_file_data_kernel(size - copied, fileno(infile), in_offset, fileno(outfile), method);
+            if(in_offset != NULL)
+                fseeko(infile, offset, SEEK_SET);
+            if(stats != NULL)
+                stats->bytes[method] += copied - ahead;
+        }
+    }
+    /* whatever the kernel refused goes the classic way */
+    if(copied < size) {
+        if(copy_file_data_buffered(size - copied, infile, outfile) != size - copied)
+            return -1;
+        if(stats != NULL)
+            stats->bytes[COPY_METHOD_BUFFERED] += size - copied;
+    }
+    return size;
+}
+
+void print_copy_statistics(copy_statistics_t *stats) {
+    static const char * names[COPY_METHOD_COUNT] = {"buffered", "copy_file_range", "splice", "sendfile"};
+    int i;
+    fprintf(stderr, "copied");
+    for(i = 0; i < COPY_METHOD_COUNT; i ++)
+        fprintf(stderr, " %ld bytes %s%s", stats->bytes[i], names[i], (i < COPY_METHOD_COUNT -1) ? "," : "\n");
+}
+
 uint64_t write_central_directory_entry(uint64_t offset, local_file_header_t * header, FILE* outfile) {
     uint16_t extended_size;
     void * extended;
@@ -195,9 +343,17 @@ uint64_t write_central_directory_entry(uint64_t offset, local_file_header_t * he
 
 uint64_t write_central_directory(local_file_header_storage_t * storage, FILE *outfile) {
     uint64_t written =0;
-    uint64_t a;
-    for(a =0; a < storage->count; a ++) {
-        written += write_central_directory_entry(storage->offsets[a], storage->headers[a], outfile);
+    uint64_t a =0;
+    header_arena_block_t * block;
+    /* walk the arena, the headers are in the same order as the offsets */
+    for(block = storage->first; block != NULL; block = block->next) {
+        uint64_t used = 0;
+        while(used < block->used) {
+            local_file_header_t * header = (local_file_header_t *)(((char *)(block +1)) + used);
+            written += write_central_directory_entry(storage->offsets[a], header, outfile);
+            used += sizeof(*header) + header->file_name_length + header->extra_field_length;
+            a ++;
+        }
     }
     return written;
 }
@@ -262,22 +418,228 @@ uint64_t write_end_of_central_directory(uint64_t offset, uint64_t cd_offset, uin
     return written;
 }
 
+/* room for a header of size bytes at the end of the arena */
+local_file_header_t * storage_add_header(local_file_header_storage_t  *storage, uint64_t size) {
+    header_arena_block_t * block = storage->last;
+    local_file_header_t * header;
+    if((block == NULL) || (block->used + size > block->size)) {
+        uint64_t block_size = HEADER_ARENA_BLOCK;
+        if(block_size < size)
+            block_size = size;
+        block = malloc(sizeof(*block) + block_size);
+        block->next = NULL;
+        block->used = 0;
+        block->size = block_size;
+        if(storage->last != NULL)
+            storage->last->next = block;
+        else
+            storage->first = block;
+        storage->last = block;
+    }
+    header = (local_file_header_t *)(((char *)(block +1)) + block->used);
+    block->used += size;
+    return header;
+}
+
+/* The empty local file header of a rejected tile: stored, zip 1.0, no extra
+ * field. The other fields are ones the central directory entry has too, so it
+ * is the same whether the tile's local header was read or not. */
+local_file_header_t * placeholder_header(local_file_header_storage_t  *storage, const char * name,
+        uint16_t name_length, uint16_t flags, uint16_t time, uint16_t date) {
+    local_file_header_t * header = storage_add_header(storage, sizeof(*header) + name_length);
+    memset(header, 0, sizeof(*header));
+    header->local_file_header_signature = LOCAL_FILE_HEADER_SIGNATURE;
+    header->version_needed_to_extract = 0x000a; /* version 1.0 */
+    header->general_purpose_bit_flag = flags;
+    header->last_mod_file_time = time;
+    header->last_mod_file_date = date;
+    header->file_name_length = name_length;
+    memcpy(header +1, name, name_length);
+    return header;
+}
+
+/* header must be the last one handed out by storage_add_header */
 void remember_local_file (local_file_header_storage_t  *storage, local_file_header_t * header, uint64_t offset) {
-    storage->headers = reallocarray(storage->headers, storage->count +1, sizeof(local_file_header_t*));
-    storage->offsets = reallocarray(storage->offsets, storage->count +1, sizeof(uint64_t));
-    storage->headers[storage->count] = header;
+    if(storage->count == storage->allocated) {
+        storage->allocated = (storage->allocated == 0) ? 1024 : storage->allocated * 2;
+        storage->offsets = reallocarray(storage->offsets, storage->allocated, sizeof(uint64_t));
+        storage->sizes = reallocarray(storage->sizes, storage->allocated, sizeof(uint64_t));
+        storage->crcs = reallocarray(storage->crcs, storage->allocated, sizeof(uint32_t));
+    }
     storage->offsets[storage->count] = offset;
+    storage->sizes[storage->count] = get_file_length(header);
+    storage->crcs[storage->count] = header->crc32;
     storage->count ++;
 }
 
+/* the local file remembered at slot was written later, or with other data */
+void update_local_file (local_file_header_storage_t  *storage, uint64_t slot, local_file_header_t * header,
+                        uint64_t offset) {
+    storage->offsets[slot] = offset;
+    storage->sizes[slot] = get_file_length(header);
+    storage->crcs[slot] = header->crc32;
+}
+
 void free_storage(local_file_header_storage_t  *storage) {
-    uint64_t i;
-    for(i = 0; i < storage->count; i ++) {
-        if(storage->headers[i] != NULL)
-            free(storage->headers[i]);
+    header_arena_block_t * block = storage->first;
+    while(block != NULL) {
+        header_arena_block_t * next = block->next;
+        free(block);
+        block = next;
     }
-    if(storage->headers != NULL)
-        free(storage->headers);
     if(storage->offsets != NULL)
         free(storage->offsets);
+    if(storage->sizes != NULL)
+        free(storage->sizes);
+    if(storage->crcs != NULL)
+        free(storage->crcs);
+    memset(storage, 0, sizeof(*storage));
+}
+
+/* resolve offset and size of a directory entry, both may live in the zip64 extension */
+static void get_central_directory_entry(central_directory_header_t * header, central_directory_entry_t * entry) {
+    char * extra;
+    uint64_t used =0;
+    entry->header = header;
+    entry->offset = header->relative_offset_of_local_header;
+    entry->compressed_size = header->compressed_size;
+    if((header->relative_offset_of_local_header != 0xFFFFFFFF) && (header->compressed_size != 0xFFFFFFFF))
+        return;
+    extra = ((char *)(header +1)) + header->file_name_length;
+    while(used + sizeof(extra_field_header_t) <= header->extra_field_length) {
+        extra_field_header_t * field = (extra_field_header_t *)(extra + used);
+        if(field->header_id == ZIP64_EXTENDED_INFORMATION_ID) {
+            /* the values sit at any byte of the directory, read them one by one */
+            char * values = (char *)(field +1);
+            uint64_t count = field->data_size / sizeof(uint64_t);
+            uint64_t index = 0;
+            /* NavIT writes only the offset, regardless of the 32 bit size fields */
+            if(field->data_size == sizeof(uint64_t)) {
+                memcpy(&(entry->offset), values, sizeof(entry->offset));
+                return;
+            }
+            /* zip spec: only the fields saturated in the header are present, in fixed order */
+            if(header->uncompressed_size == 0xFFFFFFFF)
+                index ++;
+            if((header->compressed_size == 0xFFFFFFFF) && (index < count))
+                memcpy(&(entry->compressed_size), values + sizeof(uint64_t) * index ++, sizeof(entry->compressed_size));
+            if((header->relative_offset_of_local_header == 0xFFFFFFFF) && (index < count))
+                memcpy(&(entry->offset), values + sizeof(uint64_t) * index, sizeof(entry->offset));
+            return;
+        }
+        used += sizeof(extra_field_header_t) + field->data_size;
+    }
+}
+
+int read_central_directory(binfile_input_t * input, central_directory_t * directory) {
+    uint64_t filesize;
+    uint64_t tail_size;
+    uint64_t tail_offset;
+    uint64_t used;
+    int64_t i;
+    char * tail;
+    char * entries;
+    end_of_central_dir_t * eoc = NULL;
+    zip64_end_of_central_dir_locator_t locator;
+    end_of_central_dir_64_t eoc64;
+
+    memset(directory, 0, sizeof(*directory));
+    if(!input->seekable || (fseeko(input->file, 0, SEEK_END) != 0))
+        return -1;
+    filesize = ftello(input->file);
+    /* end of central directory is at the end, followed by an up to 64k comment */
+    tail_size = sizeof(*eoc) + 0xFFFF;
+    if(tail_size > filesize)
+        tail_size = filesize;
+    if(tail_size < sizeof(*eoc) + sizeof(locator))
+        return -1;
+    tail_offset = filesize - tail_size;
+    if((input_seek(input, tail_offset) != 0) || ((tail = input_peek(input, tail_size)) == NULL))
+        return -1;
+    for(i = tail_size - sizeof(*eoc); i >= 0; i --) {
+        end_of_central_dir_t * candidate = (end_of_central_dir_t *)(tail + i);
+        if((candidate->end_of_central_dir_signature == END_OF_CENTRAL_DIR_SIGNATURE)
+                && (i + sizeof(*eoc) + candidate->file_comment_length == tail_size)) {
+            eoc = candidate;
+            break;
+        }
+    }
+    /* NavIT binfiles are always zip64, so the locator is right in front */
+    if((eoc == NULL) || (tail_offset + i < sizeof(locator)))
+        return -1;
+    if((input_seek(input, tail_offset + i - sizeof(locator)) != 0)
+            || (input_read(input, &locator, sizeof(locator)) != 0))
+        return -1;
+    if(locator.zip64_end_of_central_dir_locator_signature != ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIGNATURE)
+        return -1;
+    if((input_seek(input, locator.end_of_central_directory_offset) != 0)
+            || (input_read(input, &eoc64, sizeof(eoc64)) != 0))
+        return -1;
+    if(eoc64.end_of_central_dir_64_signature != END_OF_CENTRAL_DIR_64_SIGNATURE)
+        return -1;
+    if(eoc64.central_directory_offset + eoc64.central_directory_size > filesize)
+        return -1;
+
+    directory->size = filesize - eoc64.central_directory_offset;
+    directory->entries = calloc(eoc64.central_directory_count_total, sizeof(central_directory_entry_t));
+    if(directory->entries == NULL)
+        return -1;
+    if(input_seek(input, eoc64.central_directory_offset) != 0) {
+        free_central_directory(directory);
+        return -1;
+    }
+    if(input->map != NULL) {
+        /* parse in place */
+        entries = input->map + eoc64.central_directory_offset;
+    } else {
+        directory->buffer = malloc(eoc64.central_directory_size);
+        if((directory->buffer == NULL)
+                || (input_read(input, directory->buffer, eoc64.central_directory_size) != 0)) {
+            free_central_directory(directory);
+            return -1;
+        }
+        entries = directory->buffer;
+    }
+    used = 0;
+    while((directory->count < eoc64.central_directory_count_total)
+            && (used + sizeof(central_directory_header_t) <= eoc64.central_directory_size)) {
+        central_directory_header_t * header = (central_directory_header_t *)(entries + used);
+        if(header->central_file_header_signature != CENTRAL_DIRECTORY_HEADER_SIGNATURE)
+            break;
+        used += sizeof(*header) + header->file_name_length + header->extra_field_length + header->file_comment_length;
+        if(used > eoc64.central_directory_size)
+            break;
+        get_central_directory_entry(header, &(directory->entries[directory->count]));
+        directory->count ++;
+    }
+    if(directory->count != eoc64.central_directory_count_total) {
+        fprintf(stderr, "ERROR central directory damaged after %ld of %ld entries\n", directory->count,
+                eoc64.central_directory_count_total);
+        free_central_directory(directory);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_central_directory_entry(const void * a, const void * b) {
+    const central_directory_entry_t * ea = a;
+    const central_directory_entry_t * eb = b;
+    if(ea->offset != eb->offset)
+        return (ea->offset < eb->offset) ? -1 : 1;
+    /* entries sharing a local header keep their directory order */
+    if(ea->header != eb->header)
+        return (ea->header < eb->header) ? -1 : 1;
+    return 0;
+}
+
+void sort_central_directory(central_directory_t * directory) {
+    qsort(directory->entries, directory->count, sizeof(central_directory_entry_t), compare_central_directory_entry);
+}
+
+void free_central_directory(central_directory_t * directory) {
+    if(directory->buffer != NULL)
+        free(directory->buffer);
+    if(directory->entries != NULL)
+        free(directory->entries);
+    memset(directory, 0, sizeof(*directory));
 }
@@ -151,23 +151,80 @@ typedef union zipfile_part {
 } zipfile_part_t;
 #pragma pack(pop)
 
+/* Headers live back to back in a chain of arena blocks, in the order they were
+ * written. Offset, size and crc of entry n are in the arrays at index n. */
+#define HEADER_ARENA_BLOCK (1024*1024)
+
+typedef struct header_arena_block header_arena_block_t;
+struct header_arena_block {
+    header_arena_block_t * next;
+    uint64_t used;
+    uint64_t size;
+    /* headers follow */
+};
+
 typedef struct local_file_header_storage local_file_header_storage_t;
 struct local_file_header_storage {
-    local_file_header_t ** headers;
+    header_arena_block_t * first;
+    header_arena_block_t * last;
     uint64_t * offsets;
+    uint64_t * sizes;
+    uint32_t * crcs;
     uint64_t count;
+    uint64_t allocated;
+};
+
+typedef struct central_directory_entry central_directory_entry_t;
+struct central_directory_entry {
+    central_directory_header_t * header; /* points into central_directory.buffer or the input map */
+    uint64_t offset; /* offset of the local file header, zip64 extension resolved */
+    uint64_t compressed_size;
+};
+
+typedef struct central_directory central_directory_t;
+struct central_directory {
+    char * buffer;
+    central_directory_entry_t * entries;
+    uint64_t count;
+    uint64_t size; /* of directory and trailer in the binfile */
+};
+
+enum copy_method {
+    COPY_METHOD_BUFFERED,
+    COPY_METHOD_COPY_FILE_RANGE,
+    COPY_METHOD_SPLICE,
+    COPY_METHOD_SENDFILE,
+    COPY_METHOD_COUNT
+};
+
+typedef struct copy_statistics copy_statistics_t;
+struct copy_statistics {
+    uint64_t bytes[COPY_METHOD_COUNT]; /* tile data bytes moved, by enum copy_method */
 };
 
 zip64_extended_information_t * get_zip64_extension (local_file_header_t* header);
 uint64_t get_file_length (local_file_header_t  *header);
+/* whether a header found by its signature alone is one, the name has to follow it */
+int plausible_local_file_header (local_file_header_t *header);
+int plausible_central_directory_header (central_directory_header_t *header);
 void patch_file_length (uint64_t offset, local_file_header_t  *header, uint64_t filesize);
-uint64_t copy_file_data (uint64_t size, FILE* infile, FILE*outfile);
+uint64_t copy_file_data (uint64_t size, FILE* infile, FILE*outfile, copy_statistics_t *stats);
+void print_copy_statistics(copy_statistics_t *stats);
 uint64_t write_central_directory_entry(uint64_t offset, local_file_header_t * header, FILE* outfile);
 uint64_t write_end_of_central_directory(uint64_t offset, uint64_t cd_offset, uint64_t size,
                                         local_file_header_storage_t *storage,
                                         FILE * outfile);
 
 uint64_t write_central_directory(local_file_header_storage_t * storage, FILE *outfile);
+local_file_header_t * storage_add_header(local_file_header_storage_t  *storage, uint64_t size);
+local_file_header_t * placeholder_header(local_file_header_storage_t  *storage, const char * name,
+        uint16_t name_length, uint16_t flags, uint16_t time, uint16_t date);
 void remember_local_file (local_file_header_storage_t  *storage, local_file_header_t * header, uint64_t offset);
+void update_local_file (local_file_header_storage_t  *storage, uint64_t slot, local_file_header_t * header,
+                        uint64_t offset);
 void free_storage(local_file_header_storage_t  *storage);
+struct binfile_input;
+int read_central_directory(struct binfile_input * input, central_directory_t * directory);
+void sort_central_directory(central_directory_t * directory);
+void free_central_directory(central_directory_t * directory);
 #endif
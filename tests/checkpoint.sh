@@ -0,0 +1,45 @@
+# A run killed anywhere and started again gives the output of an uninterrupted
+# run byte for byte. The runs are killed by the file size limit, with SIGXFSZ
+# when the output reaches it, so the kill points are the same on every machine.
+. "$(dirname "$0")/common.sh"
+
+box="-180 -90 180 90"
+"$GENERATOR" -n 60000 -z uniform:16:512 -o map.bin > /dev/null 2>&1 || fail "generator"
+"$EXTRACTOR" $box < map.bin > reference.bin 2> /dev/null || fail "reference"
+
+# run <file size limit>, in blocks of ulimit -f, 512 or 1024 bytes depending on
+# the shell, the limits below work with both. The outer subshell waits for the
+# run, so the shell reports the signal to /dev/null.
+run() {
+    (
+        (
+            ulimit -f $1
+            exec "$EXTRACTOR" --checkpoint=run.ck --checkpoint-interval=1 $box < map.bin 1<> out.bin
+        )
+        status=$?
+        exit $status
+    ) 2> /dev/null
+}
+
+# killed once, before the first checkpoint, at a tile boundary or anywhere else
+for limit in 100 2001 5003 9007 14011; do
+    rm -f out.bin run.ck
+    run $limit && fail "run limited to $limit blocks not killed"
+    "$EXTRACTOR" --checkpoint=run.ck --checkpoint-interval=1 $box < map.bin 1<> out.bin 2> run.log \
+        || fail "run after $limit blocks"
+    [ $limit -gt 100 ] && ! grep -q "^resuming" run.log && fail "run after $limit blocks didn't resume"
+    [ -e run.ck ] && fail "checkpoint left behind after $limit blocks"
+    compare "killed at $limit blocks" reference.bin out.bin
+done
+
+# killed again and again, every run gets a bit further
+rm -f out.bin run.ck
+for limit in 1501 3001 4507 6007 7501 9001 10513 12007 13501; do
+    run $limit && fail "run limited to $limit blocks not killed"
+done
+"$EXTRACTOR" --checkpoint=run.ck --checkpoint-interval=1 $box < map.bin 1<> out.bin 2> run.log || fail "last run"
+grep -q "^resuming" run.log || fail "last run didn't resume"
+[ -e run.ck ] && fail "checkpoint left behind"
+compare "killed nine times" reference.bin out.bin
+
+finish
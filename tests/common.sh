@@ -0,0 +1,32 @@
+# Shared setup of the tests, sourced with the extractor, the generator and
+# the lookup tool as arguments. Every test works in its own temporary directory.
+EXTRACTOR=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+GENERATOR=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+LOOKUP=$(cd "$(dirname "$3")" && pwd)/$(basename "$3")
+shift 3
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+cd "$TMP" || exit 1
+
+failed=0
+
+fail() {
+    echo "FAIL $*" >&2
+    failed=1
+}
+
+# a small map, 20000 tiles of up to 512 bytes
+generate() {
+    "$GENERATOR" -n 20000 -z uniform:16:512 "$@" > /dev/null 2>&1
+}
+
+# compare <name> <expected> <result>
+compare() {
+    cmp -s "$2" "$3" || fail "$1: $3 differs from $2"
+}
+
+finish() {
+    [ $failed -eq 0 ] && echo "all ok"
+    exit $failed
+}
@@ -0,0 +1,35 @@
+# NavIT finds every tile of a --compact extract by its number: the directory
+# entry leads to a local file header with the same name, sizes and CRC as in
+# the plain extract, placeholders to an empty one.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" index < map.bin > map.idx 2> /dev/null || fail "index"
+
+for box in "-180 -90 180 90" "11.3 47.9 11.7 48.2" "-10 35 30 60" "170 -50 180 -40"; do
+    "$EXTRACTOR" $box < map.bin > plain.bin 2> /dev/null || fail "$box plain"
+    "$LOOKUP" plain.bin > plain.txt || fail "$box plain lookup"
+    cat map.bin | "$EXTRACTOR" --compact $box > piped.bin 2> /dev/null || fail "$box piped"
+    "$EXTRACTOR" --compact $box < map.bin > file.bin 2> /dev/null || fail "$box file"
+    "$EXTRACTOR" -i map.idx --compact $box < map.bin > index.bin 2> /dev/null || fail "$box index"
+    for compact in piped file index; do
+        "$LOOKUP" $compact.bin > $compact.txt || fail "$box $compact lookup"
+        compare "$box $compact tiles" plain.txt $compact.txt
+    done
+    [ $(wc -c < file.bin) -lt $(wc -c < plain.bin) ] || fail "$box compact isn't smaller"
+done
+
+# several outputs in one pass, each compact on its own
+printf 'a.bin 11.3 47.9 11.7 48.2\nb.bin -10 35 30 60\n' > jobs
+"$EXTRACTOR" --compact -f jobs < map.bin 2> /dev/null || fail "jobs"
+for job in "a.bin 11.3 47.9 11.7 48.2" "b.bin -10 35 30 60"; do
+    set -- $job
+    output=$1
+    shift
+    "$EXTRACTOR" "$@" < map.bin > plain.bin 2> /dev/null || fail "$output plain"
+    "$LOOKUP" plain.bin > plain.txt
+    "$LOOKUP" $output > $output.txt || fail "$output lookup"
+    compare "$output tiles" plain.txt $output.txt
+done
+
+finish
@@ -0,0 +1,54 @@
+# The quadtree prefix cover over the sorted names must select the same
+# tiles with and without a tile index, whatever the box: random ones of every
+# size, boxes on the edges of tiles, empty and world sized ones. The boxes
+# come from a fixed seed, so a failing one fails again.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" index < map.bin > map.idx 2> /dev/null || fail "index"
+
+awk 'BEGIN {
+    srand(1)
+    pi = atan2(0, -1)
+    r = 6371000
+    # world sized and empty ones
+    print "-180 -90 180 90"
+    print "-179.9999 -85.05 179.9999 85.05"
+    print "-200 -89 200 89"
+    print "11.5 48.1 11.5 48.1"
+    print "11.5 48.1 11.5 48.2"
+    print "-30 60 -20 60"
+    print "180 -20 180 -15"
+    print "-180 -90 -179.9999 -89.9999"
+    # anywhere, from a kilometer or two to the whole world wide
+    for (i = 0; i < 150; i++) {
+        lon = rand() * 360 - 180
+        lat = rand() * 170 - 85
+        w = exp(log(10) * (rand() * 4.5 - 4)) * 180
+        h = exp(log(10) * (rand() * 4.5 - 4)) * 85
+        printf "%.6f %.6f %.6f %.6f\n", lon, lat, min(lon + w, 180), min(lat + h, 85)
+    }
+    # on the edges of a tile, or of its overlap into the neighbours
+    for (i = 0; i < 100; i++) {
+        depth = 1 + int(rand() * 14)
+        cells = 2 ^ depth
+        x = int(rand() * cells)
+        y = int(rand() * cells)
+        size = 40000000 / cells
+        overlap = (i % 2) * int(size * 2 / 100)
+        printf "%.10f %.10f %.10f %.10f\n", lon_of(-20000000 + x * size - overlap),
+            lat_of(-20000000 + y * size - overlap), lon_of(-20000000 + (x + 1) * size + overlap),
+            lat_of(-20000000 + (y + 1) * size + overlap)
+    }
+}
+function min(a, b) { return a < b ? a : b }
+function lon_of(x) { return x * 180 / (r * pi) }
+function lat_of(y) { return (2 * atan2(exp(y / r), 1) - pi / 2) * 180 / pi }' > boxes
+
+while read box; do
+    "$EXTRACTOR" $box < map.bin > plain.bin 2> /dev/null || fail "$box without index"
+    "$EXTRACTOR" -i map.idx $box < map.bin > index.bin 2> /dev/null || fail "$box with index"
+    compare "$box" plain.bin index.bin
+done < boxes
+
+finish
@@ -0,0 +1,95 @@
+# Extracts answered by serve over a Unix socket are the ones of a direct
+# extraction, byte for byte, also for clients at once and across a binfile
+# replaced while serving, and the client fails on a cut off answer.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" serve -j 2 "$TMP/socket" "$TMP/map.bin" 2> serve.log &
+server=$!
+trap 'kill $server 2> /dev/null; rm -rf "$TMP"' EXIT
+i=0
+while [ ! -S socket ] && [ $i -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+done
+
+i=0
+for request in "-180 -90 180 90" "11.3 47.9 11.7 48.2" "-10 35 30 60" "5.8 47.2 15.1 55.1 1000"; do
+    i=$((i + 1))
+    set -- $request
+    if [ $# -eq 5 ]; then
+        "$EXTRACTOR" -c $5 $1 $2 $3 $4 < map.bin > direct$i.bin 2> /dev/null || fail "$request direct"
+    else
+        "$EXTRACTOR" $request < map.bin > direct$i.bin 2> /dev/null || fail "$request direct"
+    fi
+    "$EXTRACTOR" request "$TMP/socket" $request > served$i.bin 2> /dev/null || fail "$request served"
+    compare "$request" direct$i.bin served$i.bin
+done
+
+for request in "1 2 3" "1 2 3 4 1e300" "1 2 3 4 -2" "1 2 3 4 nan"; do
+    "$EXTRACTOR" request "$TMP/socket" $request > /dev/null 2>&1 && fail "bad request $request passed"
+done
+"$EXTRACTOR" request "$TMP/socket" 11.3 47.9 11.7 48.2 > served.bin 2> /dev/null || fail "request after bad ones"
+compare "request after bad ones" direct2.bin served.bin
+
+# more clients at once than the server runs, the others wait in the queue
+i=0
+clients=
+for request in "-180 -90 180 90" "11.3 47.9 11.7 48.2" "-10 35 30 60" "-180 -90 180 90" \
+        "11.3 47.9 11.7 48.2" "-10 35 30 60" "-180 -90 180 90" "11.3 47.9 11.7 48.2"; do
+    i=$((i + 1))
+    "$EXTRACTOR" request "$TMP/socket" $request > parallel$i.bin 2> /dev/null &
+    clients="$clients $!"
+done
+for client in $clients; do
+    wait $client || fail "parallel request"
+done
+i=0
+for direct in 1 2 3 1 2 3 1 2; do
+    i=$((i + 1))
+    compare "parallel request $i" direct$direct.bin parallel$i.bin
+done
+
+# a new binfile renamed over the served one, with requests running meanwhile
+"$GENERATOR" -n 20000 -z uniform:16:512 -s 2 -o new.bin > /dev/null 2>&1
+"$EXTRACTOR" 11.3 47.9 11.7 48.2 < new.bin > new2.bin 2> /dev/null || fail "new direct"
+"$EXTRACTOR" -10 35 30 60 < new.bin > new3.bin 2> /dev/null || fail "new direct"
+cmp -s direct2.bin new2.bin && fail "new binfile extracts like the old one"
+clients=
+for i in 1 2 3 4; do
+    "$EXTRACTOR" request "$TMP/socket" 11.3 47.9 11.7 48.2 > swap$i.bin 2> /dev/null &
+    clients="$clients $!"
+done
+cp new.bin next.bin
+mv next.bin map.bin
+for client in $clients; do
+    wait $client || fail "request during the swap"
+done
+for i in 1 2 3 4; do
+    cmp -s direct2.bin swap$i.bin || cmp -s new2.bin swap$i.bin || fail "request $i during the swap"
+done
+i=0
+while [ $i -lt 50 ]; do
+    "$EXTRACTOR" request "$TMP/socket" 11.3 47.9 11.7 48.2 > swapped.bin 2> /dev/null || fail "request after the swap"
+    cmp -s new2.bin swapped.bin && break
+    sleep 0.1
+    i=$((i + 1))
+done
+compare "first request on the new binfile" new2.bin swapped.bin
+"$EXTRACTOR" request "$TMP/socket" -10 35 30 60 > swapped.bin 2> /dev/null || fail "request after the swap"
+compare "later request on the new binfile" new3.bin swapped.bin
+
+# a server killed in the middle of the answer, the client blocks on a full fifo
+mkfifo answer
+"$EXTRACTOR" request "$TMP/socket" -180 -90 180 90 > answer 2> /dev/null &
+client=$!
+exec 3< answer
+sleep 1
+kill -9 $server
+wait $server 2> /dev/null
+cat <&3 > cut.bin
+exec 3<&-
+wait $client && fail "cut off answer passed"
+cmp -s cut.bin served1.bin && fail "answer not cut off"
+
+finish
@@ -0,0 +1,34 @@
+# Patches between plain and compact extracts give the new binfile back byte
+# for byte, one between equal compact binfiles stays small, and a damaged
+# one is refused.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" 11.3 47.9 11.7 48.2 < map.bin > city.bin 2> /dev/null || fail "city"
+"$EXTRACTOR" --compact 11.3 47.9 11.7 48.2 < map.bin > city-compact.bin 2> /dev/null || fail "compact city"
+"$EXTRACTOR" -10 35 30 60 < map.bin > europe.bin 2> /dev/null || fail "europe"
+"$EXTRACTOR" --compact -10 35 30 60 < map.bin > europe-compact.bin 2> /dev/null || fail "compact europe"
+
+for old in city city-compact europe europe-compact; do
+    for new in city city-compact europe europe-compact; do
+        "$EXTRACTOR" diff $old.bin $new.bin > patch 2> /dev/null || fail "diff $old $new"
+        cat patch | "$EXTRACTOR" apply $old.bin > applied.bin 2> /dev/null || fail "apply $old $new"
+        compare "$old to $new" $new.bin applied.bin
+    done
+done
+
+for name in city city-compact; do
+    "$EXTRACTOR" diff $name.bin $name.bin > patch 2> /dev/null || fail "diff $name"
+    [ $(wc -c < patch) -lt 1024 ] || fail "patch from $name to itself has $(wc -c < patch) bytes"
+done
+
+# a damaged tile count in the header or the first op fails before any work
+"$EXTRACTOR" diff city.bin europe.bin > patch 2> /dev/null || fail "diff city europe"
+for offset in 32 64; do
+    cp patch damaged
+    printf '\377\377\377\377\377\377\377\017' | dd of=damaged bs=1 seek=$offset conv=notrunc 2> /dev/null
+    "$EXTRACTOR" apply city.bin < damaged > applied.bin 2> /dev/null && fail "count at $offset damaged passed"
+    [ $(wc -c < applied.bin) -le $(wc -c < europe.bin) ] || fail "count at $offset damaged wrote too much"
+done
+
+finish
@@ -0,0 +1,187 @@
+/*
+ * navit_binfile_extractor - a tool to extract smaller regions out of
+ * ready made Navit binfiles
+ * Copyright (C) 2005-2019 Navit Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Looks up every tile of a binfile by its number the way NavIT does: the
+ * central directory entry gives the offset, the local file header there the
+ * size of the data behind it. Prints number, name, sizes and CRC of every
+ * tile, one per line, so the tests can compare two binfiles tile by tile.
+ * Written against the zip structures only, none of the extractor's code. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+#include "zipfile.h"
+
+static char * binfile;
+static uint64_t binfile_size;
+
+/* size bytes at offset, NULL if they are beyond the end */
+static void * at(uint64_t offset, uint64_t size) {
+    if((offset > binfile_size) || (size > binfile_size - offset))
+        return NULL;
+    return binfile + offset;
+}
+
+static int read_binfile(const char * path) {
+    FILE * infile = fopen(path, "r");
+    if(infile == NULL) {
+        fprintf(stderr, "ERROR opening %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fseeko(infile, 0, SEEK_END);
+    binfile_size = ftello(infile);
+    fseeko(infile, 0, SEEK_SET);
+    binfile = malloc(binfile_size +1);
+    if((binfile == NULL) || (fread(binfile, 1, binfile_size, infile) != binfile_size)) {
+        fprintf(stderr, "ERROR reading %s\n", path);
+        fclose(infile);
+        return -1;
+    }
+    fclose(infile);
+    return 0;
+}
+
+/* the data of the zip64 extension in an extra field, NULL if there is none */
+static char * zip64_data(char * extra, uint16_t length, uint16_t * size) {
+    extra_field_header_t field;
+    uint64_t used = 0;
+
+    while(used + sizeof(field) <= length) {
+        memcpy(&field, extra + used, sizeof(field));
+        if(field.header_id == ZIP64_EXTENDED_INFORMATION_ID) {
+            *size = field.data_size;
+            return extra + used + sizeof(field);
+        }
+        used += sizeof(field) + field.data_size;
+    }
+    return NULL;
+}
+
+/* the local header offset, from the zip64 extension if the entry has one like NavIT's */
+static uint64_t local_offset(central_directory_header_t * entry) {
+    uint64_t offset = UINT64_MAX;
+    uint16_t size;
+    char * zip64;
+
+    if(entry->relative_offset_of_local_header != 0xFFFFFFFF)
+        return entry->relative_offset_of_local_header;
+    zip64 = zip64_data((char *)(entry +1) + entry->file_name_length, entry->extra_field_length, &size);
+    /* NavIT's own with just the offset, or all the fields */
+    if((zip64 != NULL) && (size == sizeof(uint64_t)))
+        memcpy(&offset, zip64, sizeof(offset));
+    else if((zip64 != NULL) && (size >= 3 * sizeof(uint64_t)))
+        memcpy(&offset, zip64 + 2 * sizeof(uint64_t), sizeof(offset));
+    return offset;
+}
+
+/* sizes of the data behind a local file header, from its zip64 extension if it has one */
+static void local_sizes(local_file_header_t * local, uint64_t * compressed, uint64_t * uncompressed) {
+    uint16_t size;
+    char * zip64 = zip64_data((char *)(local +1) + local->file_name_length, local->extra_field_length, &size);
+
+    *compressed = local->compressed_size;
+    *uncompressed = local->uncompressed_size;
+    if((zip64 != NULL) && (size >= 2 * sizeof(uint64_t))) {
+        memcpy(uncompressed, zip64, sizeof(*uncompressed));
+        memcpy(compressed, zip64 + sizeof(uint64_t), sizeof(*compressed));
+    }
+}
+
+static int lookup_tiles(void) {
+    end_of_central_dir_t * end;
+    zip64_end_of_central_dir_locator_t * locator;
+    end_of_central_dir_64_t * end64;
+    uint64_t count;
+    uint64_t used;
+    uint64_t i;
+
+    end = at(binfile_size - sizeof(*end), sizeof(*end));
+    locator = at(binfile_size - sizeof(*end) - sizeof(*locator), sizeof(*locator));
+    if((end == NULL) || (end->end_of_central_dir_signature != END_OF_CENTRAL_DIR_SIGNATURE)
+            || (locator == NULL)
+            || (locator->zip64_end_of_central_dir_locator_signature != ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIGNATURE)) {
+        fprintf(stderr, "ERROR no zip64 end of central directory\n");
+        return 1;
+    }
+    end64 = at(locator->end_of_central_directory_offset, sizeof(*end64));
+    if((end64 == NULL) || (end64->end_of_central_dir_64_signature != END_OF_CENTRAL_DIR_64_SIGNATURE)) {
+        fprintf(stderr, "ERROR no zip64 end of central directory record\n");
+        return 1;
+    }
+    count = end64->central_directory_count_total;
+    used = end64->central_directory_offset;
+    for(i = 0; i < count; i ++) {
+        central_directory_header_t * entry = at(used, sizeof(*entry));
+        local_file_header_t * local;
+        char * name;
+        char * data;
+        uint64_t offset;
+        uint64_t compressed;
+        uint64_t uncompressed;
+
+        if((entry == NULL) || (entry->central_file_header_signature != CENTRAL_DIRECTORY_HEADER_SIGNATURE)
+                || ((entry = at(used, sizeof(*entry) + entry->file_name_length + entry->extra_field_length
+                                + entry->file_comment_length)) == NULL)) {
+            fprintf(stderr, "ERROR no central directory entry %ld at offset %ld\n", i, used);
+            return 1;
+        }
+        used += sizeof(*entry) + entry->file_name_length + entry->extra_field_length + entry->file_comment_length;
+        name = (char *)(entry +1);
+        offset = local_offset(entry);
+        local = at(offset, sizeof(*local));
+        if((local == NULL) || (local->local_file_header_signature != LOCAL_FILE_HEADER_SIGNATURE)
+                || ((local = at(offset, sizeof(*local) + local->file_name_length + local->extra_field_length)) == NULL)) {
+            fprintf(stderr, "ERROR tile %ld %.*s: no local file header at offset %ld\n", i, entry->file_name_length,
+                    name, offset);
+            return 1;
+        }
+        local_sizes(local, &compressed, &uncompressed);
+        /* an empty tile may share another one's header, one with data has to be its own */
+        if((compressed > 0) && ((local->file_name_length != entry->file_name_length)
+                                || (memcmp(local +1, name, entry->file_name_length) != 0))) {
+            fprintf(stderr, "ERROR tile %ld %.*s: local file header of %.*s\n", i, entry->file_name_length, name,
+                    local->file_name_length, (char *)(local +1));
+            return 1;
+        }
+        data = at(offset + sizeof(*local) + local->file_name_length + local->extra_field_length, compressed);
+        if(data == NULL) {
+            fprintf(stderr, "ERROR tile %ld %.*s: data beyond the end\n", i, entry->file_name_length, name);
+            return 1;
+        }
+        printf("%ld %.*s %ld %ld %08x %08lx\n", i, entry->file_name_length, name, compressed, uncompressed,
+               local->crc32, crc32(0, (Bytef *)data, compressed));
+    }
+    return 0;
+}
+
+int main (int argc, char ** argv) {
+    if(argc != 2) {
+        fprintf(stderr, "usage: navit_binfile_lookup <binfile>\n");
+        return 1;
+    }
+    if(read_binfile(argv[1]) != 0)
+        return 1;
+    return lookup_tiles();
+}
@@ -0,0 +1,21 @@
+# A binfile given as a regular file, through a tile index or through a pipe
+# gives the same extract byte for byte, placeholders included.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" index < map.bin > map.idx 2> /dev/null || fail "index"
+
+for box in "-180 -90 180 90" "11.3 47.9 11.7 48.2" "-10 35 30 60"; do
+    for options in "" "--compact" "-c 1000"; do
+        cat map.bin | "$EXTRACTOR" $options $box > piped.bin 2> /dev/null || fail "$options $box piped"
+        "$EXTRACTOR" $options $box < map.bin > file.bin 2> /dev/null || fail "$options $box file"
+        "$EXTRACTOR" -i map.idx $options $box < map.bin > index.bin 2> /dev/null || fail "$options $box index"
+        compare "$options $box file" piped.bin file.bin
+        compare "$options $box index" piped.bin index.bin
+    done
+    "$EXTRACTOR" -j 4 -i map.idx $box < map.bin > parallel.bin 2> /dev/null || fail "$box parallel"
+    cat map.bin | "$EXTRACTOR" $box > piped.bin 2> /dev/null
+    compare "$box parallel" piped.bin parallel.bin
+done
+
+finish
@@ -0,0 +1,47 @@
+# --plan prints the size every output has when it is really written, for
+# plain and --compact extracts, read from a file, a pipe or with an index,
+# and for every output of a jobs file. With -c the size is an upper bound.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+"$EXTRACTOR" index < map.bin > map.idx 2> /dev/null || fail "index"
+
+# planned <plan line>, the bytes of it
+planned() {
+    echo "$1" | sed -n 's/.*"bytes":\([0-9]*\),"exact":true,.*/\1/p'
+}
+
+for box in "-180 -90 180 90" "11.3 47.9 11.7 48.2" "-10 35 30 60" "170 -50 180 -40"; do
+    for mode in "" "--compact"; do
+        "$EXTRACTOR" $mode $box < map.bin > out.bin 2> /dev/null || fail "$box $mode extract"
+        size=$(stat -c %s out.bin)
+        file=$("$EXTRACTOR" --plan $mode $box < map.bin 2> /dev/null) || fail "$box $mode plan"
+        piped=$(cat map.bin | "$EXTRACTOR" --plan $mode $box 2> /dev/null) || fail "$box $mode piped plan"
+        index=$("$EXTRACTOR" -i map.idx --plan $mode $box < map.bin 2> /dev/null) || fail "$box $mode index plan"
+        [ "$(planned "$file")" = "$size" ] || fail "$box $mode: planned $(planned "$file"), wrote $size"
+        [ "$(planned "$piped")" = "$size" ] || fail "$box $mode piped: planned $(planned "$piped"), wrote $size"
+        [ "$(planned "$index")" = "$size" ] || fail "$box $mode index: planned $(planned "$index"), wrote $size"
+    done
+done
+
+# one line per output of a jobs file, in the order of the file
+printf 'a.bin 11.3 47.9 11.7 48.2\nb.bin -10 35 30 60\nc.bin 170 -50 180 -40\n' > jobs
+for mode in "" "--compact"; do
+    "$EXTRACTOR" $mode -f jobs < map.bin 2> /dev/null || fail "jobs $mode extract"
+    "$EXTRACTOR" --plan $mode -f jobs < map.bin > plan.txt 2> /dev/null || fail "jobs $mode plan"
+    [ $(wc -l < plan.txt) -eq 3 ] || fail "jobs $mode: $(wc -l < plan.txt) plan lines"
+    for output in a.bin b.bin c.bin; do
+        line=$(grep "^{\"output\":\"$output\"," plan.txt)
+        [ "$(planned "$line")" = "$(stat -c %s $output)" ] \
+            || fail "jobs $mode $output: planned $(planned "$line"), wrote $(stat -c %s $output)"
+    done
+done
+
+# clipped tiles only get smaller
+"$EXTRACTOR" -c 1000 -10 35 30 60 < map.bin > out.bin 2> /dev/null || fail "clipped extract"
+line=$("$EXTRACTOR" --plan -c 1000 -10 35 30 60 < map.bin 2> /dev/null) || fail "clipped plan"
+echo "$line" | grep -q '"exact":false,' || fail "clipped plan claims to be exact"
+bytes=$(echo "$line" | sed -n 's/.*"bytes":\([0-9]*\),.*/\1/p')
+[ -n "$bytes" ] && [ "$bytes" -ge $(stat -c %s out.bin) ] || fail "clipped: planned $bytes, wrote $(stat -c %s out.bin)"
+
+finish
@@ -0,0 +1,106 @@
+# Extracts of polygon files keep the tiles of every outline and none of the
+# ones in its holes: an island in a lake and two separate areas, as Osmosis
+# .poly and as GeoJSON with other geometries beside the polygons.
+. "$(dirname "$0")/common.sh"
+
+generate -o map.bin
+
+# extract <name> <extractor arguments>, lists the tiles with data in name.txt
+extract() {
+    name=$1
+    shift
+    "$EXTRACTOR" "$@" < map.bin > $name.bin 2> /dev/null || fail "$name"
+    "$LOOKUP" $name.bin | awk '$3 > 0 { print $2 }' | sort > $name.txt
+}
+
+# nothing in the first list but what's in the second
+subset() {
+    [ -z "$(comm -23 "$2" "$3")" ] || fail "$1: $2 has tiles $3 doesn't"
+}
+
+cat > lake.poly << 'EOF'
+island in a lake
+land
+-60 40
+0 40
+0 80
+-60 80
+END
+!lake
+-50 48
+-10 48
+-10 72
+-50 72
+END
+island
+-40 55
+-20 55
+-20 65
+-40 65
+END
+END
+EOF
+cat > lake.json << 'EOF'
+{"type": "FeatureCollection", "features": [
+  {"type": "Feature", "properties": {"name": "harbour"},
+   "geometry": {"type": "Point", "coordinates": [-30.0, 60.0]}},
+  {"type": "Feature", "properties": {"name": "ferry"},
+   "geometry": {"type": "LineString", "coordinates": [[-45, 60], [-30, 60]]}},
+  {"type": "Feature", "properties": {"name": "island in a lake"},
+   "geometry": {"coordinates": [
+     [[[-60, 40], [0, 40], [0, 80], [-60, 80], [-60, 40]],
+      [[-50, 48], [-10, 48], [-10, 72], [-50, 72], [-50, 48]]],
+     [[[-40, 55], [-20, 55], [-20, 65], [-40, 65], [-40, 55]]]],
+    "type": "MultiPolygon"}}
+]}
+EOF
+
+extract land -60 40 0 80
+extract island -40 55 -20 65
+extract lake -48 50 -42 70
+awk 'length($0) >= 9' lake.txt > deep.txt
+[ -s deep.txt ] || fail "no deep tiles in the lake"
+for polygon in lake.poly lake.json; do
+    extract $polygon -p $polygon
+    subset "$polygon" $polygon.txt land.txt
+    subset "$polygon island" island.txt $polygon.txt
+    [ -z "$(comm -12 deep.txt $polygon.txt)" ] || fail "$polygon keeps tiles in the lake"
+done
+compare "GeoJSON lake" lake.poly.bin lake.json.bin
+
+cat > apart.poly << 'EOF'
+two areas
+west
+-60 40
+-40 40
+-40 60
+-60 60
+END
+east
+-20 60
+0 60
+0 80
+-20 80
+END
+END
+EOF
+cat > apart.json << 'EOF'
+{"type": "FeatureCollection", "features": [
+  {"type": "Feature", "geometry": {"type": "Polygon",
+   "coordinates": [[[-60, 40], [-40, 40], [-40, 60], [-60, 60], [-60, 40]]]}},
+  {"type": "Feature", "geometry": {"type": "MultiPoint", "coordinates": [[-50, 50], [-10, 70]]}},
+  {"type": "Feature", "geometry": {"type": "Polygon",
+   "coordinates": [[[-20, 60], [0, 60], [0, 80], [-20, 80], [-20, 60]]]}}
+]}
+EOF
+
+extract west -60 40 -40 60
+extract east -20 60 0 80
+sort -u west.txt east.txt > both.txt
+for polygon in apart.poly apart.json; do
+    extract $polygon -p $polygon
+    compare "$polygon tiles" both.txt $polygon.txt
+done
+compare "GeoJSON areas" apart.poly.bin apart.json.bin
+
+finish
@@ -0,0 +1,31 @@
+# A streamed binfile with unknown data between its records gives the same
+# extract, one cut off inside a record fails and counts a damaged tail.
+. "$(dirname "$0")/common.sh"
+
+box="-10 35 30 60"
+generate -o map.bin
+cat map.bin | "$EXTRACTOR" $box > clean.bin 2> /dev/null || fail "clean map"
+
+# offset of the 5000th local file header
+offset=$(grep -obUa "$(printf 'PK\003\004')" map.bin | sed -n '5000s/:.*//p')
+
+# text with half a signature and one without a header behind it
+head -c $offset map.bin > inserted.bin
+printf 'PK\003\003 gap PK\003\004 not a tile PPPP' >> inserted.bin
+tail -c +$((offset + 1)) map.bin >> inserted.bin
+cat inserted.bin | "$EXTRACTOR" --stats=json $box > resynced.bin 2> resynced.log || fail "inserted data"
+compare "inserted data" clean.bin resynced.bin
+grep -q '"resync":{"gaps":1,"bytes":29}' resynced.log || fail "inserted data not counted"
+
+# cut off inside the header, then inside the data of a tile
+for cut in 10 -10; do
+    head -c $((offset + cut)) map.bin > truncated.bin
+    "$EXTRACTOR" --stats=json $box < truncated.bin > /dev/null 2> file.log && fail "file cut at $cut passed"
+    cat truncated.bin | "$EXTRACTOR" --stats=json $box > /dev/null 2> pipe.log && fail "pipe cut at $cut passed"
+    for log in file.log pipe.log; do
+        grep -q "ERROR damaged tail" $log || fail "$log cut at $cut: no damaged tail"
+        grep -q '"resync":{"gaps":1,' $log || fail "$log cut at $cut: not counted"
+    done
+done
+
+finish
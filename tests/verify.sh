@@ -0,0 +1,37 @@
+# --verify passes a sound map through unchanged, also while clipping or
+# recompressing from a pipe, and fails the run on a damaged kept tile.
+. "$(dirname "$0")/common.sh"
+
+box="11.3 47.9 11.7 48.2"
+generate -o map.bin
+
+for options in "" "-c 1000" "--recompress" "-c 1000 --recompress"; do
+    cat map.bin | "$EXTRACTOR" $options $box > plain.bin 2> /dev/null || fail "$options plain"
+    cat map.bin | "$EXTRACTOR" --verify --stats-file=piped.json $options $box > piped.bin 2> /dev/null \
+        || fail "$options --verify piped"
+    "$EXTRACTOR" --verify --stats-file=file.json $options $box < map.bin > file.bin 2> /dev/null \
+        || fail "$options --verify file"
+    compare "$options --verify piped" plain.bin piped.bin
+    compare "$options --verify file" plain.bin file.bin
+    grep -q '"mismatches":0,' piped.json || fail "$options --verify piped counts a mismatch"
+    grep -q '"mismatches":0,' file.json || fail "$options --verify file counts a mismatch"
+done
+
+# the first file is the index tile, kept in every extract, damage its data
+name_length=$(od -A n -t u2 -j 26 -N 2 map.bin)
+extra_length=$(od -A n -t u2 -j 28 -N 2 map.bin)
+cp map.bin damaged.bin
+printf '\377' | dd of=damaged.bin bs=1 seek=$((30 + name_length + extra_length + 4)) conv=notrunc 2> /dev/null
+
+for options in "" "-c 1000" "--recompress"; do
+    if cat damaged.bin | "$EXTRACTOR" --verify --stats-file=piped.json $options $box > piped.bin 2> /dev/null; then
+        fail "$options --verify piped passes a damaged tile"
+    fi
+    if "$EXTRACTOR" --verify --stats-file=file.json $options $box < damaged.bin > file.bin 2> /dev/null; then
+        fail "$options --verify file passes a damaged tile"
+    fi
+    grep -q '"mismatches":1,' piped.json || fail "$options --verify piped doesn't count the damaged tile"
+    grep -q '"mismatches":1,' file.json || fail "$options --verify file doesn't count the damaged tile"
+done
+
+finish